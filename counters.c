@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include "value.h"
+#include "interpreter.h"
+#include "counters.h"
+
+
+// The counts of one thread. The blocks of all threads are kept in a list
+// (and never freed, so they outlive their threads) for countersPrint().
+struct Counters {
+  long counts[NUM_COUNTERS];
+  struct Counters *next;
+  // the calls of each primitive, by its index in primitives[]
+  long primitiveCalls[];
+};
+
+typedef struct Counters Counters;
+
+int countingOn = 0;
+
+static Counters *allCounters = NULL;
+static pthread_mutex_t countersLock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local Counters *threadCounters = NULL;
+
+// the names of the counters, as countersPrint() shows them
+static const char *counterNames[NUM_COUNTERS] = {
+  "eval", "apply", "talloc-calls", "talloc-bytes", "frames",
+  "lookup-frames", "lookup-bindings"
+};
+
+
+// returns the counts of the calling thread, making them on its first count
+static Counters *countersOfThread(){
+  if (threadCounters == NULL){
+    Counters *counters = calloc(1, sizeof(Counters) + numPrimitives * sizeof(long));
+    assert(counters != NULL && "Error (countersOfThread): out of memory");
+    pthread_mutex_lock(&countersLock);
+    counters->next = allCounters;
+    allCounters = counters;
+    pthread_mutex_unlock(&countersLock);
+    threadCounters = counters;
+  }
+  return threadCounters;
+}
+
+
+// prints the counts to stderr, at exit
+static void printAtExit(){
+  countersPrint(stderr);
+}
+
+
+// Turns counting on.
+void countersEnable(){
+  countingOn = 1;
+  atexit(printAtExit);
+}
+
+
+// Adds n to a counter of the calling thread.
+void countEvents(counterKind kind, long n){
+  countersOfThread()->counts[kind] += n;
+}
+
+
+// Counts a call of the primitive function.
+void countPrimitiveCall(Value *(*function)(Value *)){
+  for (int i = 0; i < numPrimitives; i++){
+    if (primitives[i].function == function){
+      countersOfThread()->primitiveCalls[i]++;
+      return;
+    }
+  }
+}
+
+
+// Prints the totals of the counters, then of the calls of each primitive
+// that was called.
+void countersPrint(FILE *stream){
+  pthread_mutex_lock(&countersLock);
+  for (int kind = 0; kind < NUM_COUNTERS; kind++){
+    long total = 0;
+    for (Counters *counters = allCounters; counters != NULL; counters = counters->next){
+      total += counters->counts[kind];
+    }
+    fprintf(stream, "%s %ld\n", counterNames[kind], total);
+  }
+  for (int i = 0; i < numPrimitives; i++){
+    long total = 0;
+    for (Counters *counters = allCounters; counters != NULL; counters = counters->next){
+      total += counters->primitiveCalls[i];
+    }
+    if (total > 0){
+      fprintf(stream, "primitive:%s %ld\n", primitives[i].name, total);
+    }
+  }
+  pthread_mutex_unlock(&countersLock);
+  fflush(stream);
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include "value.h"
+
+#ifndef _COUNTERS
+#define _COUNTERS
+
+// Event counters for benchmarking by counts instead of time
+// (./interpreter --count). Unlike timings, the counts of a program are the
+// same on every run and every machine, so a change in them is a change in
+// the work the interpreter does. They are off by default; the code that
+// counts checks countingOn first, so that they cost one branch otherwise.
+// Each thread counts in a block of its own, and the blocks are added up
+// when printed.
+//
+// To keep them the same on every run, the talloc counts leave out the
+// tables of the literal pool (see intern.h): it hashes cons cells by
+// address, so when its tables grow depends on where the heap lands. They
+// are allocated with tallocUncounted() (see talloc.h).
+typedef enum {
+  // calls to eval()
+  COUNT_EVAL,
+  // calls to apply() and applyArray(), of closures and primitives
+  COUNT_APPLY,
+  // calls to talloc(), and the bytes they asked for
+  COUNT_TALLOC,
+  COUNT_TALLOC_BYTES,
+  // frames created for calls, lets and handlers
+  COUNT_FRAMES,
+  // frames lookUpSymbol() looked in, and bindings whose names it compared
+  COUNT_LOOKUP_FRAMES,
+  COUNT_LOOKUP_BINDINGS,
+  NUM_COUNTERS
+} counterKind;
+
+// non-zero once countersEnable() has been called
+extern int countingOn;
+
+// Turns counting on, and prints the counts (see countersPrint()) to stderr
+// when the process exits, even when it exits with an error.
+void countersEnable();
+
+// Adds n to a counter of the calling thread.
+void countEvents(counterKind kind, long n);
+
+// Counts a call of the primitive function (one of primitives[], see
+// interpreter.h).
+void countPrimitiveCall(Value *(*function)(Value *));
+
+// Prints each counter, and the calls of each primitive called at all, on
+// a line of its own as its name and its total over all threads.
+void countersPrint(FILE *stream);
+
+#endif
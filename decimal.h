@@ -0,0 +1,22 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _DECIMAL
+#define _DECIMAL
+
+// Converts decimal numbers to the nearest double, as strtod() does, but
+// from the digits the tokenizer has already accumulated: mantissa holds the
+// first (at most 19) significant digits of the number, and the number is
+// mantissa times 10 to the exponent, unless truncated is non-zero, when
+// some non-zero digits came after those. text is the number's text (of
+// length bytes, digits with an optional '.' and exponent), which is only
+// read in the rare cases the fast methods can't decide.
+//
+// Most numbers take one multiplication or division of doubles (Clinger's
+// fast path) or, with more digits or a larger exponent, one or two 128-bit
+// multiplications by a table of powers of ten (the Eisel-Lemire
+// algorithm).
+double decimalToDouble(uint64_t mantissa, long exponent, int truncated,
+                       const char *text, size_t length);
+
+#endif
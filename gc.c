@@ -0,0 +1,535 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <time.h>
+#include "heap.h"
+#include "gc.h"
+
+
+// A cycle starts once this many bytes (or as many bytes as were live after
+// the previous cycle, if that is more) have been talloc'd since the last one
+#define MIN_TRIGGER_BYTES (4 * 1024 * 1024)
+// During an incremental cycle, a step is due every STEP_BYTES of allocation
+#define STEP_BYTES (32 * 1024)
+// How many objects are scanned between two checks of the pause target
+#define OBJECTS_PER_CLOCK_CHECK 64
+// Whatever the pause target, a step scans (while marking) or sweeps at least
+// WORK_PER_BYTE bytes for every byte talloc'd since the step before. Marking
+// grows by one byte per byte talloc'd (new blocks are grey), and sweeping
+// only covers the slabs there were when it started, so with more than one
+// byte of work per byte each cycle is sure to end.
+#define WORK_PER_BYTE 4
+// Upper bounds (in microseconds) of the buckets of the pause-time histogram;
+// the last bucket holds every longer pause
+#define NUM_BUCKETS 6
+static const long bucketLimits[NUM_BUCKETS - 1] = {10, 100, 1000, 10000, 100000};
+
+
+typedef enum { IDLE, MARKING, SWEEPING } gcPhase;
+
+// A block that is marked but whose contents have not been scanned yet
+struct GreyBlock {
+  char *start;
+  size_t size;
+};
+
+// A registered range of memory outside the heap that is scanned for pointers
+struct RootRange {
+  char *start;
+  size_t size;
+};
+
+typedef struct GreyBlock GreyBlock;
+typedef struct RootRange RootRange;
+
+
+// configuration from gcInit(), including the heap being collected
+static gcMode mode = GC_OFF;
+static Heap *gcHeap = NULL;
+static char *stackBase = NULL;
+static long budgetNanos = 0;
+
+// where the current cycle is
+static gcPhase phase = IDLE;
+static int stepPending = 0;
+static size_t bytesSinceCycle = 0;
+static size_t bytesSinceStep = 0;
+static size_t heapBytes = 0;
+static size_t triggerBytes = MIN_TRIGGER_BYTES;
+static Slab *sweepCursor = NULL;
+
+// open-addressing hash set of every slab, used to tell whether a word
+// points into a slab
+static Slab **slabSet = NULL;
+static size_t slabSetCapacity = 0;
+static size_t slabSetCount = 0;
+
+// the grey blocks (the mark stack)
+static GreyBlock *greyStack = NULL;
+static size_t greyCount = 0;
+static size_t greyCapacity = 0;
+
+// registered root ranges
+static RootRange *roots = NULL;
+static size_t rootCount = 0;
+static size_t rootCapacity = 0;
+
+// address range covering every large block, to skip the large block list
+// quickly for words that cannot point into one
+static char *largeLow = NULL;
+static char *largeHigh = NULL;
+
+// statistics for gcPrintStats()
+static long numCycles = 0;
+static long numPauses = 0;
+static size_t bytesReclaimed = 0;
+static long long totalPauseNanos = 0;
+static long long maxPauseNanos = 0;
+static long pauseHistogram[NUM_BUCKETS];
+
+
+// returns the current time in nanoseconds
+static long long nowNanos(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+// returns the slot of slab in the slab set, or the empty
+// slot where it would go
+static Slab **findSlabSlot(Slab *slab){
+  size_t index = ((uintptr_t)slab / SLAB_SIZE) & (slabSetCapacity - 1);
+  while (slabSet[index] != NULL && slabSet[index] != slab){
+    index = (index + 1) & (slabSetCapacity - 1);
+  }
+  return &slabSet[index];
+}
+
+
+// adds a slab to the slab set, growing the set when it is half full
+static void addToSlabSet(Slab *slab){
+  if (2 * (slabSetCount + 1) > slabSetCapacity){
+    Slab **oldSet = slabSet;
+    size_t oldCapacity = slabSetCapacity;
+    slabSetCapacity = (oldCapacity == 0) ? 256 : oldCapacity * 2;
+    slabSet = calloc(slabSetCapacity, sizeof(Slab *));
+    assert(slabSet != NULL && "Error (gc): out of memory");
+    for (size_t i = 0; i < oldCapacity; i++){
+      if (oldSet[i] != NULL){
+        *findSlabSlot(oldSet[i]) = oldSet[i];
+      }
+    }
+    free(oldSet);
+  }
+  *findSlabSlot(slab) = slab;
+  slabSetCount++;
+}
+
+
+// pushes a marked block onto the grey stack
+static void pushGrey(char *start, size_t size){
+  if (greyCount == greyCapacity){
+    greyCapacity = (greyCapacity == 0) ? 1024 : greyCapacity * 2;
+    greyStack = realloc(greyStack, greyCapacity * sizeof(GreyBlock));
+    assert(greyStack != NULL && "Error (gc): out of memory");
+  }
+  greyStack[greyCount].start = start;
+  greyStack[greyCount].size = size;
+  greyCount++;
+}
+
+
+// marks the talloc'd block that word points into (if any) and
+// pushes it onto the grey stack if it was not marked before
+static void markWord(uintptr_t word){
+  if (slabSetCapacity != 0){
+    Slab *slab = slabOf((void *)word);
+    if (slab != NULL && *findSlabSlot(slab) == slab){
+      if ((char *)word < slab->firstCell){
+        return;
+      }
+      size_t index = cellIndex(slab, (void *)word);
+      if (index >= slab->numCells){
+        return;
+      }
+      uint64_t bit = 1ULL << (index % 64);
+      if ((slab->allocated[index / 64] & bit) && !(slab->marked[index / 64] & bit)){
+        slab->marked[index / 64] |= bit;
+        pushGrey(slab->firstCell + index * slab->cellSize, slab->cellSize);
+      }
+      return;
+    }
+  }
+  if ((char *)word < largeLow || (char *)word >= largeHigh){
+    return;
+  }
+  for (LargeBlock *block = gcHeap->largeList; block != NULL; block = block->next){
+    char *payload = (char *)(block + 1);
+    if ((char *)word >= payload && (char *)word < payload + block->size){
+      if (!block->marked){
+        block->marked = 1;
+        pushGrey(payload, block->size);
+      }
+      return;
+    }
+  }
+}
+
+
+// marks every block that a word in [start, end) points into
+static void scanRange(char *start, char *end){
+  uintptr_t first = ((uintptr_t)start + sizeof(uintptr_t) - 1) & ~(uintptr_t)(sizeof(uintptr_t) - 1);
+  for (uintptr_t *cur = (uintptr_t *)first; (char *)(cur + 1) <= end; cur++){
+    markWord(*cur);
+  }
+}
+
+
+// marks everything the roots point to: the registers, the C stack
+// and the registered root ranges
+static void scanRoots(){
+  // setjmp spills the callee-saved registers into regs, on the stack
+  jmp_buf regs;
+  setjmp(regs);
+  scanRange((char *)&regs, stackBase);
+  for (size_t i = 0; i < rootCount; i++){
+    scanRange(roots[i].start, roots[i].start + roots[i].size);
+  }
+}
+
+
+// scans grey blocks until none are left (returns 1) or the deadline has
+// passed once at least minBytes were scanned (returns 0); a deadline of 0
+// means no deadline
+static int drainGrey(long long deadline, size_t minBytes){
+  int sinceCheck = 0;
+  size_t scanned = 0;
+  while (greyCount > 0){
+    greyCount--;
+    GreyBlock block = greyStack[greyCount];
+    scanRange(block.start, block.start + block.size);
+    scanned += block.size;
+    sinceCheck++;
+    if (deadline != 0 && sinceCheck >= OBJECTS_PER_CLOCK_CHECK && scanned >= minBytes){
+      sinceCheck = 0;
+      if (nowNanos() >= deadline){
+        return greyCount == 0;
+      }
+    }
+  }
+  return 1;
+}
+
+
+// frees every large block that was not marked, and clears the
+// marks of the others
+static void sweepLargeBlocks(){
+  LargeBlock **link = &(gcHeap->largeList);
+  largeLow = NULL;
+  largeHigh = NULL;
+  while (*link != NULL){
+    LargeBlock *block = *link;
+    if (!block->marked){
+      *link = block->next;
+      if (block->next != NULL){
+        block->next->prev = block->prev;
+      }
+      bytesReclaimed += block->size;
+      heapBytes -= block->size;
+      free(block);
+    }
+    else{
+      block->marked = 0;
+      char *payload = (char *)(block + 1);
+      if (largeLow == NULL || payload < largeLow){
+        largeLow = payload;
+      }
+      if (payload + block->size > largeHigh){
+        largeHigh = payload + block->size;
+      }
+      link = &(block->next);
+    }
+  }
+}
+
+
+// puts every allocated but unmarked cell of a slab on the free list
+// of its pool, and clears the marks of the others
+static void sweepSlab(Slab *slab){
+  Pool *pool = poolOf(slab->cellSize / GRANULE - 1);
+  for (size_t w = 0; w < BITMAP_WORDS; w++){
+    uint64_t dead = slab->allocated[w] & ~(slab->marked[w]);
+    while (dead != 0){
+      int bit = __builtin_ctzll(dead);
+      dead &= dead - 1;
+      void *cell = slab->firstCell + (w * 64 + bit) * slab->cellSize;
+      *(void **)cell = pool->freeList;
+      pool->freeList = cell;
+      bytesReclaimed += slab->cellSize;
+      heapBytes -= slab->cellSize;
+    }
+    slab->allocated[w] &= slab->marked[w];
+    slab->marked[w] = 0;
+  }
+  slab->swept = 1;
+}
+
+
+// starts a cycle by marking what the roots point to
+static void startMarking(){
+  phase = MARKING;
+  bytesSinceCycle = 0;
+  scanRoots();
+}
+
+
+// ends the marking phase once nothing is grey even after the roots are
+// scanned again (the stack and registers are not covered by the write
+// barrier), and starts sweeping; returns 0 instead if the deadline passed
+// (once at least minBytes were scanned) before the grey blocks the roots
+// led to were scanned, leaving them to the next step, which scans the roots
+// again. Marking still ends: every such scan that finds more to mark marks
+// a block that was white when the cycle started, since the ones talloc'd
+// since are marked already.
+static int finishMarking(long long deadline, size_t minBytes){
+  scanRoots();
+  if (!drainGrey(deadline, minBytes)){
+    return 0;
+  }
+  sweepLargeBlocks();
+  for (Slab *slab = gcHeap->slabList; slab != NULL; slab = slab->next){
+    slab->swept = 0;
+  }
+  sweepCursor = gcHeap->slabList;
+  phase = SWEEPING;
+  return 1;
+}
+
+
+// sweeps slabs until all are swept (ending the cycle) or the deadline
+// has passed once at least minBytes of slabs were swept; a deadline of 0
+// means no deadline
+static void sweepSlabs(long long deadline, size_t minBytes){
+  size_t swept = 0;
+  while (sweepCursor != NULL){
+    sweepSlab(sweepCursor);
+    sweepCursor = sweepCursor->next;
+    swept += SLAB_SIZE;
+    if (deadline != 0 && swept >= minBytes && nowNanos() >= deadline){
+      return;
+    }
+  }
+  phase = IDLE;
+  numCycles++;
+  triggerBytes = (heapBytes > MIN_TRIGGER_BYTES) ? heapBytes : MIN_TRIGGER_BYTES;
+}
+
+
+// records the length of one pause
+static void recordPause(long long nanos){
+  numPauses++;
+  totalPauseNanos += nanos;
+  if (nanos > maxPauseNanos){
+    maxPauseNanos = nanos;
+  }
+  int bucket = 0;
+  while (bucket < NUM_BUCKETS - 1 && nanos >= bucketLimits[bucket] * 1000LL){
+    bucket++;
+  }
+  pauseHistogram[bucket]++;
+}
+
+
+// does one pause worth of collection work
+static void gcStep(){
+  long long start = nowNanos();
+  // (what was talloc'd before the cycle started adds no work)
+  size_t minWork = (phase == IDLE) ? 0 : WORK_PER_BYTE * bytesSinceStep;
+  stepPending = 0;
+  bytesSinceStep = 0;
+  if (mode == GC_STOP_THE_WORLD){
+    startMarking();
+    drainGrey(0, 0);
+    finishMarking(0, 0);
+    sweepSlabs(0, 0);
+  }
+  else{
+    long long deadline = start + budgetNanos;
+    if (phase == IDLE){
+      startMarking();
+    }
+    if (phase == MARKING && drainGrey(deadline, minWork)){
+      finishMarking(deadline, minWork);
+    }
+    if (phase == SWEEPING){
+      sweepSlabs(deadline, minWork);
+    }
+  }
+  recordPause(nowNanos() - start);
+}
+
+
+// Enables the collector. Must be called before the first talloc.
+void gcInit(gcMode newMode, void *newStackBase, long budgetMicros){
+  mode = newMode;
+  gcHeap = currentHeap;
+  gcHeap->collected = (mode != GC_OFF);
+  stackBase = newStackBase;
+  budgetNanos = budgetMicros * 1000;
+}
+
+
+// Registers memory outside the heap that can hold pointers into the heap.
+void gcAddRoots(void *start, size_t size){
+  if (rootCount == rootCapacity){
+    rootCapacity = (rootCapacity == 0) ? 16 : rootCapacity * 2;
+    roots = realloc(roots, rootCapacity * sizeof(RootRange));
+    assert(roots != NULL && "Error (gc): out of memory");
+  }
+  roots[rootCount].start = start;
+  roots[rootCount].size = size;
+  rootCount++;
+}
+
+
+// Records that pointer is about to be stored into an existing object. While
+// marking, the stored block is marked right away, so that an object that was
+// already scanned can never hide an unmarked one.
+void gcWriteBarrier(void *pointer){
+  if (phase == MARKING && currentHeap == gcHeap){
+    markWord((uintptr_t)pointer);
+  }
+}
+
+
+// Gives the collector a chance to run.
+void gcSafepoint(){
+  if (stepPending && currentHeap == gcHeap){
+    gcStep();
+  }
+}
+
+
+// talloc.c hook: a new slab was created
+void gcNoteSlab(Slab *slab){
+  memset(slab->allocated, 0, sizeof(slab->allocated));
+  memset(slab->marked, 0, sizeof(slab->marked));
+  // cells in a slab created during sweeping are all new,
+  // so the slab has nothing to sweep
+  slab->swept = 1;
+  addToSlabSet(slab);
+}
+
+
+// talloc.c hook: a block was handed out. Blocks allocated while marking are
+// marked and grey (they are scanned once initialized, by rule (1) in gc.h);
+// blocks allocated while sweeping are marked if their slab has not been
+// swept yet, so that the sweep keeps them.
+void gcNoteAlloc(void *pointer, size_t size){
+  if (size > MAX_SMALL_SIZE){
+    LargeBlock *block = (LargeBlock *)pointer - 1;
+    heapBytes += size;
+    if (largeLow == NULL || (char *)pointer < largeLow){
+      largeLow = pointer;
+    }
+    if ((char *)pointer + size > largeHigh){
+      largeHigh = (char *)pointer + size;
+    }
+    if (phase == MARKING){
+      block->marked = 1;
+      pushGrey(pointer, size);
+    }
+  }
+  else{
+    Slab *slab = slabOf(pointer);
+    size_t index = cellIndex(slab, pointer);
+    uint64_t bit = 1ULL << (index % 64);
+    slab->allocated[index / 64] |= bit;
+    heapBytes += slab->cellSize;
+    if (phase == MARKING){
+      slab->marked[index / 64] |= bit;
+      pushGrey(pointer, slab->cellSize);
+    }
+    else if (phase == SWEEPING && !slab->swept){
+      slab->marked[index / 64] |= bit;
+    }
+  }
+  bytesSinceCycle += size;
+  bytesSinceStep += size;
+  if (phase == IDLE){
+    if (bytesSinceCycle >= triggerBytes){
+      stepPending = 1;
+    }
+  }
+  else if (bytesSinceStep >= STEP_BYTES){
+    stepPending = 1;
+  }
+}
+
+
+// talloc.c hook: a cell was handed back with trelease()
+void gcNoteRelease(void *pointer, size_t size){
+  // (the slab's cell size is what was counted)
+  (void)size;
+  Slab *slab = slabOf(pointer);
+  size_t index = cellIndex(slab, pointer);
+  uint64_t bit = 1ULL << (index % 64);
+  if (slab->allocated[index / 64] & bit){
+    heapBytes -= slab->cellSize;
+  }
+  slab->allocated[index / 64] &= ~bit;
+  slab->marked[index / 64] &= ~bit;
+}
+
+
+// talloc.c hook: all memory was freed by tfree()
+void gcReset(){
+  free(slabSet);
+  slabSet = NULL;
+  slabSetCapacity = 0;
+  slabSetCount = 0;
+  free(greyStack);
+  greyStack = NULL;
+  greyCount = 0;
+  greyCapacity = 0;
+  largeLow = NULL;
+  largeHigh = NULL;
+  phase = IDLE;
+  stepPending = 0;
+  bytesSinceCycle = 0;
+  bytesSinceStep = 0;
+  heapBytes = 0;
+  triggerBytes = MIN_TRIGGER_BYTES;
+  sweepCursor = NULL;
+}
+
+
+// Prints the number of collections, the bytes reclaimed and a histogram of
+// pause times to stderr.
+void gcPrintStats(){
+  const char *modeName = (mode == GC_INCREMENTAL) ? "incremental" : "stop-the-world";
+  if (mode == GC_OFF){
+    modeName = "off";
+  }
+  fprintf(stderr, "gc: mode %s, %ld cycles, %ld pauses, %zu bytes reclaimed\n",
+          modeName, numCycles, numPauses, bytesReclaimed);
+  if (numPauses == 0){
+    return;
+  }
+  fprintf(stderr, "gc: pause max %.3f ms, mean %.3f ms\n",
+          maxPauseNanos / 1e6, (totalPauseNanos / (double)numPauses) / 1e6);
+  if (mode == GC_INCREMENTAL){
+    fprintf(stderr, "gc: pause target %ld us (not a bound, see gc.h)\n", budgetNanos / 1000);
+  }
+  for (int i = 0; i < NUM_BUCKETS; i++){
+    if (i < NUM_BUCKETS - 1){
+      fprintf(stderr, "gc:   < %6ld us: %ld\n", bucketLimits[i], pauseHistogram[i]);
+    }
+    else{
+      fprintf(stderr, "gc:  >= %6ld us: %ld\n", bucketLimits[i - 1], pauseHistogram[i]);
+    }
+  }
+}
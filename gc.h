@@ -0,0 +1,58 @@
+#include <stddef.h>
+
+#ifndef _GC
+#define _GC
+
+// The collector is off by default: talloc'd memory then lives until tfree(),
+// as it always has. When enabled, it is a conservative, non-moving
+// mark-sweep collector over the talloc pools. Any word on the C stack, in a
+// registered root range or inside a reachable talloc'd block that looks like
+// a pointer into a talloc'd block keeps that block alive.
+//
+// Collections only run at safepoints (see gcSafepoint()). To make that sound
+// the evaluator follows two rules:
+// (1) a talloc'd object is fully initialized before the next safepoint after
+//     its allocation;
+// (2) storing a pointer into an object that existed before the last
+//     safepoint (e.g. set! overwriting a binding, or a frame getting a new
+//     bindings list) is preceded by gcWriteBarrier() on the stored pointer.
+typedef enum {
+  GC_OFF,
+  // every collection marks and sweeps the whole heap in one pause
+  GC_STOP_THE_WORLD,
+  // marking and sweeping are spread over many short pauses, each aiming at
+  // the pause target, with the write barrier keeping the marking correct
+  GC_INCREMENTAL
+} gcMode;
+
+// Enables the collector for the heap talloc is using (see activeHeap() in
+// talloc.h); other heaps are never collected, and the collector only runs on
+// threads using that heap. Must be called before the first talloc. stackBase
+// is the address of the outermost stack frame that can hold pointers into
+// the heap (e.g. __builtin_frame_address(0) in main). budgetMicros is the
+// pause target of an incremental step: a step stops marking or sweeping
+// once it has passed, but it is not a bound. The scans of the roots that
+// start marking and that end it (which the step after repeats if the rest
+// of the marking takes it past the target) cover the whole C stack, and so
+// take longer the deeper the evaluation is. And a step may take longer when
+// the program allocates faster than the target lets the collector keep up:
+// each step does an amount of work in proportion to what was talloc'd since
+// the last one, so that every cycle ends.
+void gcInit(gcMode mode, void *stackBase, long budgetMicros);
+
+// Registers memory outside the heap (e.g. a global variable) that can hold
+// pointers into the heap.
+void gcAddRoots(void *start, size_t size);
+
+// Records that pointer is about to be stored into an existing object.
+void gcWriteBarrier(void *pointer);
+
+// Gives the collector a chance to run. The evaluator calls this at the
+// start of every eval().
+void gcSafepoint();
+
+// Prints the number of collections, the bytes reclaimed, a histogram of
+// pause times and (when incremental) the pause target to stderr.
+void gcPrintStats();
+
+#endif
@@ -0,0 +1,99 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifndef _HEAP
+#define _HEAP
+
+// Layout of the memory that talloc hands out, shared by talloc.c and the
+// garbage collector in gc.c. Nothing else should include this file.
+//
+// Each small request size is rounded up to a multiple of GRANULE and served
+// from the pool of that size class. A pool carves its cells out of SLAB_SIZE
+// slabs (obtained with malloc) and keeps a free list of reclaimed cells, so
+// allocation is just a pointer pop or a pointer bump. Requests larger than
+// MAX_SMALL_SIZE bytes are malloc'd individually as large blocks.
+#define SLAB_SIZE (64 * 1024)
+#define GRANULE 8
+#define MAX_SMALL_SIZE 256
+#define NUM_CLASSES (MAX_SMALL_SIZE / GRANULE)
+#define BITMAP_WORDS (SLAB_SIZE / GRANULE / 64)
+
+
+// A slab is a header followed by the cells of one size class. Slabs are
+// aligned to SLAB_SIZE, so the slab (and size class) of any small talloc'd
+// pointer can be found by masking off its low bits. The bitmaps have one bit
+// per cell and are only kept up to date while the collector is enabled.
+struct Slab {
+  struct Slab *next;
+  size_t cellSize;
+  char *firstCell;
+  size_t numCells;
+  int swept;
+  uint64_t allocated[BITMAP_WORDS];
+  uint64_t marked[BITMAP_WORDS];
+};
+
+// Blocks larger than MAX_SMALL_SIZE are kept in a doubly linked list (so
+// that trelease() can take one out) through this header, whose 32 bytes
+// keep the payload aligned for any type.
+struct LargeBlock {
+  struct LargeBlock *next;
+  struct LargeBlock *prev;
+  size_t size;
+  size_t marked;
+};
+
+typedef struct Slab Slab;
+typedef struct LargeBlock LargeBlock;
+
+
+// One pool per size class: the free list of reclaimed cells, and the
+// unused part of the pool's newest slab
+struct Pool {
+  void *freeList;
+  char *bump;
+  char *limit;
+};
+
+typedef struct Pool Pool;
+
+
+// A heap holds every slab and large block allocated for one interpreter
+// (see heapCreate() in talloc.h). lock guards both lists, since threads of
+// the parallel mode share them. id is never reused, so a thread's pools can
+// tell which heap they serve even after it is destroyed.
+struct Heap {
+  Slab *slabList;
+  LargeBlock *largeList;
+  long id;
+  pthread_mutex_t lock;
+  // non-zero when the collector manages this heap (see gcInit() in gc.h)
+  int collected;
+};
+
+typedef struct Heap Heap;
+
+// the heap talloc uses on the calling thread
+extern _Thread_local Heap *currentHeap;
+
+
+// returns the calling thread's pool of the given size class for currentHeap
+Pool *poolOf(int class);
+
+
+// returns the slab holding a small talloc'd cell
+Slab *slabOf(void *cell);
+
+// returns the index of a cell within its slab
+size_t cellIndex(Slab *slab, void *cell);
+
+// Collector hooks called by talloc.c for the heap the collector manages: a new slab was
+// created, a cell or large block was handed out, a cell was handed back, and
+// all memory was freed.
+void gcNoteSlab(Slab *slab);
+void gcNoteAlloc(void *pointer, size_t size);
+void gcNoteRelease(void *pointer, size_t size);
+void gcReset();
+
+#endif
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "value.h"
+#include "interpreter.h"
+#include "gc.h"
+#include "ptrtable.h"
+#include "image.h"
+
+// Without MAP_FIXED_NOREPLACE the preferred address is only a hint,
+// which imageLoad() handles the same way as a refusal
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
+// Layout of an image file: the header, the objects (starting at
+// OBJECTS_OFFSET), the offsets of every pointer between objects, and the
+// fixups. Every offset is counted from the start of the file, and a pointer
+// to the object at offset k is stored as base + k.
+#define IMAGE_MAGIC "SCMIMG2"
+#define IMAGE_BASE ((uint64_t)0x200000000000)
+#define OBJECTS_OFFSET 64
+#define ALIGNMENT 8
+
+struct ImageHeader {
+  char magic[8];
+  // identifies the layout of Values and the table of primitives
+  uint64_t fingerprint;
+  // the address the file was laid out to be mapped at
+  uint64_t base;
+  uint64_t objectsSize;
+  uint64_t topFrame;
+  uint64_t numPointers;
+  uint64_t numFixups;
+};
+
+typedef struct ImageHeader ImageHeader;
+
+
+// A word that loading has to fill in: a pointer to the primitive function
+// with the given index in primitives, which moves with the binary. (The
+// shared Values of interpreter.c are copied into the image like any other
+// Value, since nothing depends on their addresses.)
+struct Fixup {
+  uint64_t offset;
+  uint64_t primitive;
+};
+
+typedef struct Fixup Fixup;
+
+
+// the kinds of objects an image holds
+typedef enum {
+  VALUE_OBJECT,
+  FRAME_OBJECT,
+  CLOSURE_OBJECT,
+  STRING_OBJECT
+} objectKind;
+
+struct PendingObject {
+  uint64_t offset;
+  objectKind kind;
+};
+
+typedef struct PendingObject PendingObject;
+
+
+// The state of imageDump(): the file being built in memory, a table from
+// the address of each object copied so far to its offset, and the
+// copied objects whose pointers are still to be rewritten (in the order
+// they were copied, from next on)
+struct ImageWriter {
+  char *bytes;
+  size_t size;
+  size_t capacity;
+  PointerTable copies;
+  PendingObject *objects;
+  size_t numObjects;
+  size_t objectsCapacity;
+  size_t next;
+  uint64_t *pointers;
+  size_t numPointers;
+  size_t pointersCapacity;
+  Fixup *fixups;
+  size_t numFixups;
+  size_t fixupsCapacity;
+  const char *error;
+};
+
+typedef struct ImageWriter ImageWriter;
+
+
+// returns a hash of everything an image depends on besides itself
+static uint64_t fingerprint(){
+  uint64_t hash = 14695981039346656037ULL;
+  uint64_t sizes[] = {sizeof(Value), sizeof(Frame), sizeof(Closure), numPrimitives};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+    hash = (hash ^ sizes[i]) * 1099511628211ULL;
+  }
+  for (int i = 0; i < numPrimitives; i++){
+    for (const char *c = primitives[i].name; *c != '\0'; c++){
+      hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    // a separator, so that names can't run together
+    hash = hash * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// makes room for one more item in a malloc'd array of count items
+static void *reserve(void *array, size_t count, size_t *capacity, size_t itemSize){
+  if (count == *capacity){
+    *capacity = (*capacity == 0) ? 256 : *capacity * 2;
+    array = realloc(array, *capacity * itemSize);
+    assert(array != NULL && "Error (image): out of memory");
+  }
+  return array;
+}
+
+
+// returns the offset of the copy of the object at pointer, copying it
+// to the end of the image first if it is not there yet
+static uint64_t copyObject(ImageWriter *writer, void *pointer, objectKind kind){
+  uint64_t offset;
+  if (pointerTableGet(&writer->copies, pointer, &offset)){
+    return offset;
+  }
+  size_t size;
+  switch (kind){
+  case VALUE_OBJECT:
+    size = sizeof(Value);
+    break;
+  case FRAME_OBJECT:
+    size = sizeof(Frame);
+    break;
+  case CLOSURE_OBJECT:
+    size = sizeof(Closure);
+    break;
+  default:
+    size = strlen(pointer) + 1;
+    break;
+  }
+  size_t padded = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+  while (writer->size + padded > writer->capacity){
+    writer->capacity *= 2;
+    writer->bytes = realloc(writer->bytes, writer->capacity);
+    assert(writer->bytes != NULL && "Error (image): out of memory");
+  }
+  offset = writer->size;
+  memcpy(writer->bytes + offset, pointer, size);
+  memset(writer->bytes + offset + size, 0, padded - size);
+  writer->size += padded;
+
+  pointerTablePut(&writer->copies, pointer, offset);
+  writer->objects = reserve(writer->objects, writer->numObjects,
+                            &writer->objectsCapacity, sizeof(PendingObject));
+  writer->objects[writer->numObjects].offset = offset;
+  writer->objects[writer->numObjects].kind = kind;
+  writer->numObjects++;
+  return offset;
+}
+
+
+// stores the value of a pointer word of the image
+static void storeWord(ImageWriter *writer, uint64_t field, uint64_t word){
+  memcpy(writer->bytes + field, &word, sizeof(word));
+}
+
+
+// records a word that loading the image has to fill in
+static void addFixup(ImageWriter *writer, uint64_t field, int primitive){
+  writer->fixups = reserve(writer->fixups, writer->numFixups,
+                           &writer->fixupsCapacity, sizeof(Fixup));
+  writer->fixups[writer->numFixups].offset = field;
+  writer->fixups[writer->numFixups].primitive = primitive;
+  writer->numFixups++;
+}
+
+
+// rewrites the pointer word at offset field of the image, which held
+// target, to point to the copy of target (copying it if needed)
+static void rewritePointer(ImageWriter *writer, uint64_t field, void *target, objectKind kind){
+  if (target == NULL){
+    return;
+  }
+  uint64_t offset = copyObject(writer, target, kind);
+  storeWord(writer, field, IMAGE_BASE + offset);
+  writer->pointers = reserve(writer->pointers, writer->numPointers,
+                             &writer->pointersCapacity, sizeof(uint64_t));
+  writer->pointers[writer->numPointers] = field;
+  writer->numPointers++;
+}
+
+
+// rewrites the pointers of a Value copied to offset
+static void rewriteValue(ImageWriter *writer, uint64_t offset){
+  Value value;
+  memcpy(&value, writer->bytes + offset, sizeof(Value));
+  switch (value.type){
+  case CONS_TYPE:
+    rewritePointer(writer, offset + offsetof(Value, c.car), value.c.car, VALUE_OBJECT);
+    rewritePointer(writer, offset + offsetof(Value, c.cdr), value.c.cdr, VALUE_OBJECT);
+    break;
+  case STR_TYPE:
+    // (the text is copied without the string buffer it may be in,
+    // see text.h, so it can't be appended to in place)
+    value.inBuffer = 0;
+    memcpy(writer->bytes + offset, &value, sizeof(Value));
+    rewritePointer(writer, offset + offsetof(Value, s), value.s, STRING_OBJECT);
+    break;
+  case SYMBOL_TYPE:
+    rewritePointer(writer, offset + offsetof(Value, s), value.s, STRING_OBJECT);
+    break;
+  case CLOSURE_TYPE:
+    rewritePointer(writer, offset + offsetof(Value, closure), value.closure, CLOSURE_OBJECT);
+    break;
+  case PRIMITIVE_TYPE:
+    for (int i = 0; i < numPrimitives; i++){
+      if (primitives[i].function == value.primFn){
+        storeWord(writer, offset + offsetof(Value, primFn), 0);
+        addFixup(writer, offset + offsetof(Value, primFn), i);
+        return;
+      }
+    }
+    writer->error = "a primitive function is not in the table of primitives";
+    break;
+  case INT_TYPE:
+  case DOUBLE_TYPE:
+  case BOOL_TYPE:
+  case NULL_TYPE:
+  case VOID_TYPE:
+    break;
+  case FUTURE_TYPE:
+    writer->error = "a future can't be saved in an image";
+    break;
+  default:
+    writer->error = "a value of this type can't be saved in an image";
+    break;
+  }
+}
+
+
+// rewrites the pointers of a Closure copied to offset, and forgets its
+// purity, which is only valid for the epochs of this process, and its memo
+static void rewriteClosure(ImageWriter *writer, uint64_t offset){
+  Closure closure;
+  memcpy(&closure, writer->bytes + offset, sizeof(Closure));
+  rewritePointer(writer, offset + offsetof(Closure, paramNames), closure.paramNames, VALUE_OBJECT);
+  rewritePointer(writer, offset + offsetof(Closure, fnBody), closure.fnBody, VALUE_OBJECT);
+  rewritePointer(writer, offset + offsetof(Closure, frame), closure.frame, FRAME_OBJECT);
+  closure.pureEpoch = -1;
+  closure.impureEpoch = -1;
+  memcpy(writer->bytes + offset + offsetof(Closure, pureEpoch), &closure.pureEpoch, sizeof(int));
+  memcpy(writer->bytes + offset + offsetof(Closure, impureEpoch), &closure.impureEpoch, sizeof(int));
+  // the results of a memoized closure are not saved: the
+  // first call after loading starts an empty memo
+  closure.memo = NULL;
+  memcpy(writer->bytes + offset + offsetof(Closure, memo), &closure.memo, sizeof(closure.memo));
+}
+
+
+// rewrites the pointers of a Frame copied to offset
+static void rewriteFrame(ImageWriter *writer, uint64_t offset){
+  Frame frame;
+  memcpy(&frame, writer->bytes + offset, sizeof(Frame));
+  rewritePointer(writer, offset + offsetof(Frame, bindings), frame.bindings, VALUE_OBJECT);
+  rewritePointer(writer, offset + offsetof(Frame, parent), frame.parent, FRAME_OBJECT);
+}
+
+
+// frees the arrays of writer
+static void freeWriter(ImageWriter *writer){
+  free(writer->bytes);
+  pointerTableFree(&writer->copies);
+  free(writer->objects);
+  free(writer->pointers);
+  free(writer->fixups);
+}
+
+
+// Saves topFrame and everything reachable from it to the file at path.
+int imageDump(Frame *topFrame, const char *path){
+  ImageWriter writer;
+  memset(&writer, 0, sizeof(writer));
+  pointerTableInit(&writer.copies);
+  writer.capacity = 64 * 1024;
+  writer.bytes = malloc(writer.capacity);
+  assert(writer.bytes != NULL && "Error (image): out of memory");
+  memset(writer.bytes, 0, OBJECTS_OFFSET);
+  writer.size = OBJECTS_OFFSET;
+
+  uint64_t top = copyObject(&writer, topFrame, FRAME_OBJECT);
+  while (writer.next < writer.numObjects && writer.error == NULL){
+    PendingObject object = writer.objects[writer.next];
+    writer.next++;
+    if (object.kind == VALUE_OBJECT){
+      rewriteValue(&writer, object.offset);
+    }
+    else if (object.kind == CLOSURE_OBJECT){
+      rewriteClosure(&writer, object.offset);
+    }
+    else if (object.kind == FRAME_OBJECT){
+      rewriteFrame(&writer, object.offset);
+    }
+  }
+  if (writer.error != NULL){
+    fprintf(stderr, "image: %s\n", writer.error);
+    freeWriter(&writer);
+    return 1;
+  }
+
+  ImageHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  header.fingerprint = fingerprint();
+  header.base = IMAGE_BASE;
+  header.objectsSize = writer.size - OBJECTS_OFFSET;
+  header.topFrame = top;
+  header.numPointers = writer.numPointers;
+  header.numFixups = writer.numFixups;
+  memcpy(writer.bytes, &header, sizeof(header));
+
+  FILE *file = fopen(path, "wb");
+  int failed = (file == NULL);
+  if (!failed){
+    failed = fwrite(writer.bytes, 1, writer.size, file) != writer.size ||
+      fwrite(writer.pointers, sizeof(uint64_t), writer.numPointers, file) != writer.numPointers ||
+      fwrite(writer.fixups, sizeof(Fixup), writer.numFixups, file) != writer.numFixups;
+    failed = (fclose(file) != 0) || failed;
+  }
+  if (failed){
+    fprintf(stderr, "image: %s: %s\n", path, strerror(errno));
+  }
+  freeWriter(&writer);
+  return failed;
+}
+
+
+// returns non-zero if every pointer word and fixup of the image mapped at
+// image is an aligned word in its objects, each fixup names a primitive and the top frame
+// is in the objects too, so that loading it writes nowhere else
+static int checkImage(char *image, ImageHeader *header){
+  uint64_t end = OBJECTS_OFFSET + header->objectsSize;
+  if (header->topFrame < OBJECTS_OFFSET || header->topFrame > end - sizeof(Frame)){
+    return 0;
+  }
+  uint64_t *pointers = (uint64_t *)(image + end);
+  for (uint64_t i = 0; i < header->numPointers; i++){
+    if (pointers[i] < OBJECTS_OFFSET || pointers[i] > end - sizeof(uint64_t) ||
+        pointers[i] % ALIGNMENT != 0){
+      return 0;
+    }
+  }
+  Fixup *fixups = (Fixup *)(pointers + header->numPointers);
+  for (uint64_t i = 0; i < header->numFixups; i++){
+    if (fixups[i].offset < OBJECTS_OFFSET + offsetof(Value, primFn) ||
+        fixups[i].offset > end - sizeof(fixups[i].offset) ||
+        fixups[i].offset % ALIGNMENT != 0 ||
+        fixups[i].primitive >= (uint64_t)numPrimitives){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+// Maps the image at path and returns its top-level frame.
+Frame *imageLoad(const char *path){
+  int fd = open(path, O_RDONLY);
+  if (fd < 0){
+    fprintf(stderr, "image: %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  ImageHeader header;
+  struct stat status;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+      fstat(fd, &status) != 0 ||
+      // (bounded first, so that the sum can't overflow)
+      header.objectsSize > (uint64_t)status.st_size ||
+      header.numPointers > (uint64_t)status.st_size / sizeof(uint64_t) ||
+      header.numFixups > (uint64_t)status.st_size / sizeof(Fixup) ||
+      header.objectsSize < sizeof(Frame) ||
+      (uint64_t)status.st_size != OBJECTS_OFFSET + header.objectsSize +
+        header.numPointers * sizeof(uint64_t) + header.numFixups * sizeof(Fixup)){
+    fprintf(stderr, "image: %s is not an image\n", path);
+    close(fd);
+    return NULL;
+  }
+  if (header.fingerprint != fingerprint()){
+    fprintf(stderr, "image: %s was made by an interpreter with other primitives\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  size_t length = status.st_size;
+  char *image = mmap((void *)(uintptr_t)header.base, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+  if (image == MAP_FAILED){
+    image = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  if (image == MAP_FAILED){
+    fprintf(stderr, "image: %s: %s\n", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  if (!checkImage(image, &header)){
+    fprintf(stderr, "image: %s is damaged\n", path);
+    munmap(image, length);
+    return NULL;
+  }
+
+  // the pointers between objects only change if the image could not be
+  // mapped where it was laid out
+  uint64_t *pointers = (uint64_t *)(image + OBJECTS_OFFSET + header.objectsSize);
+  uint64_t delta = (uint64_t)(uintptr_t)image - header.base;
+  if (delta != 0){
+    for (uint64_t i = 0; i < header.numPointers; i++){
+      *(uint64_t *)(image + pointers[i]) += delta;
+    }
+  }
+  Fixup *fixups = (Fixup *)(pointers + header.numPointers);
+  for (uint64_t i = 0; i < header.numFixups; i++){
+    Value *value = (Value *)(image + fixups[i].offset - offsetof(Value, primFn));
+    value->primFn = primitives[fixups[i].primitive].function;
+  }
+  // definitions made after loading link the image to talloc'd memory
+  gcAddRoots(image + OBJECTS_OFFSET, header.objectsSize);
+  return (Frame *)(image + header.topFrame);
+}
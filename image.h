@@ -0,0 +1,28 @@
+#include "value.h"
+
+#ifndef _IMAGE
+#define _IMAGE
+
+// An image is a snapshot of a top-level frame and everything reachable from
+// it (bindings, closures, their frames and bodies), saved to a file so that
+// a later run can start from it instead of evaluating a prelude again.
+//
+// The objects are laid out in the file exactly as in memory, for a preferred
+// address. Loading maps the file privately (so changes never reach the file)
+// and only has to rewrite the pointers when the preferred address is taken,
+// plus the few words that refer to the interpreter binary itself (the
+// primitive functions). An image can only be loaded by an interpreter with
+// the same primitives.
+
+// Saves topFrame and everything reachable from it to the file at path.
+// Returns 0, or prints the reason to stderr and returns 1 (e.g. when a
+// future is reachable, since its task can't be saved).
+int imageDump(Frame *topFrame, const char *path);
+
+// Maps the image at path and returns its top-level frame, or prints the
+// reason to stderr and returns NULL, which it also does when a pointer or
+// primitive the image lists is out of range. The image stays mapped until the
+// process exits; it is registered with the collector as a root range.
+Frame *imageLoad(const char *path);
+
+#endif
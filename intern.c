@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "value.h"
+#include "talloc.h"
+#include "intern.h"
+#include "gc.h"
+
+
+// The literal pool is split into NUM_SHARDS shards by the top bits of the
+// hash of a Value, so that several threads can add to it at once (see
+// setInternPoolConcurrent()). Each shard is an open-addressing hash table:
+// slots is an array of capacity slots (a power of 2), each a pooled Value
+// with its hash, so that probing and growing don't have to load the Values
+// (value NULL marks an empty slot). A shard is kept at most half full.
+#define NUM_SHARDS 64
+#define SHARD_BITS 6
+
+struct PoolSlot {
+  uint64_t hash;
+  Value *value;
+};
+
+typedef struct PoolSlot PoolSlot;
+
+struct PoolShard {
+  PoolSlot *slots;
+  size_t capacity;
+  size_t count;
+  pthread_mutex_t lock;
+};
+
+typedef struct PoolShard PoolShard;
+
+struct InternPool {
+  PoolShard shards[NUM_SHARDS];
+  // non-zero while lookups must lock their shard
+  int concurrent;
+};
+
+// the pool of the process, used unless an interpreter
+// context (see interp.h) switches to its own
+static InternPool defaultPool = {
+  .shards = { [0 ... NUM_SHARDS - 1] = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER } },
+  .concurrent = 0
+};
+static _Thread_local InternPool *currentPool = &defaultPool;
+
+
+// FNV-1a hash over a block of bytes, continuing from the given hash
+static uint64_t hashBytes(uint64_t hash, const void *bytes, size_t size){
+  const unsigned char *cur = bytes;
+  for (size_t i = 0; i < size; i++){
+    hash ^= cur[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// mixes the bits of x so that every bit of the result depends on all
+// of them (the finalizer of MurmurHash3)
+static uint64_t mixBits(uint64_t x){
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+
+// hashes a Value by its type and contents (for cons cells,
+// by the addresses of the already pooled car and cdr)
+static uint64_t hashValue(Value *val){
+  uint64_t hash = hashBytes(14695981039346656037ULL, &(val->type), sizeof(valueType));
+  uint64_t bits;
+  switch (val->type){
+    // (numbers are hashed in one step, as data files are full of them)
+    case INT_TYPE:
+    case BOOL_TYPE:
+      return mixBits(hash ^ (uint32_t)val->i);
+    case DOUBLE_TYPE:
+      memcpy(&bits, &(val->d), sizeof(double));
+      return mixBits(hash ^ bits);
+    case STR_TYPE:
+      return hashBytes(hash, val->s, val->length);
+    case SYMBOL_TYPE:
+      return hashBytes(hash, val->s, strlen(val->s));
+    case CONS_TYPE:
+      hash = hashBytes(hash, &((val->c).car), sizeof(Value *));
+      return hashBytes(hash, &((val->c).cdr), sizeof(Value *));
+    default:
+      // every other poolable type (e.g. NULL_TYPE, OPEN_TYPE)
+      // only has one possible value
+      return hash;
+  }
+}
+
+
+// check if two Values have the same type and contents
+static int equalValue(Value *a, Value *b){
+  if (a->type != b->type){
+    return 0;
+  }
+  switch (a->type){
+    case INT_TYPE:
+    case BOOL_TYPE:
+      return a->i == b->i;
+    case DOUBLE_TYPE:
+      // compare the bits, so that 0.0 and -0.0 stay distinct
+      return memcmp(&(a->d), &(b->d), sizeof(double)) == 0;
+    case STR_TYPE:
+      return a->length == b->length && memcmp(a->s, b->s, a->length) == 0;
+    case SYMBOL_TYPE:
+      return strcmp(a->s, b->s) == 0;
+    case CONS_TYPE:
+      return ((a->c).car == (b->c).car) && ((a->c).cdr == (b->c).cdr);
+    default:
+      return 1;
+  }
+}
+
+
+// returns the slot of shard where val is stored, or the empty
+// slot where it should be inserted if it is not in the shard
+static PoolSlot *findSlot(PoolShard *shard, Value *val, uint64_t hash){
+  size_t index = hash & (shard->capacity - 1);
+  while (shard->slots[index].value != NULL &&
+         (shard->slots[index].hash != hash || !equalValue(shard->slots[index].value, val))){
+    index = (index + 1) & (shard->capacity - 1);
+  }
+  return &(shard->slots[index]);
+}
+
+
+// the default pool is reachable only through defaultPool, so the
+// collector (which only manages the default heap) must scan it
+static pthread_once_t defaultPoolRootOnce = PTHREAD_ONCE_INIT;
+
+static void addDefaultPoolRoot(){
+  gcAddRoots(&defaultPool, sizeof(defaultPool));
+}
+
+
+// doubles the capacity of shard (or creates it) and
+// re-inserts every pooled Value
+static void growShard(PoolShard *shard){
+  PoolSlot *oldSlots = shard->slots;
+  size_t oldCapacity = shard->capacity;
+  if (currentPool == &defaultPool){
+    pthread_once(&defaultPoolRootOnce, addDefaultPoolRoot);
+  }
+  shard->capacity = (oldCapacity == 0) ? 64 : oldCapacity * 2;
+  // the tables are left out of the talloc counts (see counters.h), since
+  // when a shard fills up depends on the addresses cons cells hash by
+  PoolSlot *slots = tallocUncounted(shard->capacity * sizeof(PoolSlot));
+  memset(slots, 0, shard->capacity * sizeof(PoolSlot));
+  shard->slots = slots;
+  for (size_t i = 0; i < oldCapacity; i++){
+    if (oldSlots[i].value != NULL){
+      // (the Values are all different, so only an empty slot is searched for)
+      size_t index = oldSlots[i].hash & (shard->capacity - 1);
+      while (slots[index].value != NULL){
+        index = (index + 1) & (shard->capacity - 1);
+      }
+      slots[index] = oldSlots[i];
+    }
+  }
+  trelease(oldSlots, oldCapacity * sizeof(PoolSlot));
+}
+
+
+// returns the pooled Value equal to *val, storing
+// a copy of *val in the pool if needed
+static Value *lookUpOrAdd(Value *val){
+  uint64_t hash = hashValue(val);
+  PoolShard *shard = &currentPool->shards[hash >> (64 - SHARD_BITS)];
+  int concurrent = currentPool->concurrent;
+  if (concurrent){
+    pthread_mutex_lock(&shard->lock);
+  }
+  if (2 * (shard->count + 1) > shard->capacity){
+    growShard(shard);
+  }
+  PoolSlot *slot = findSlot(shard, val, hash);
+  if (slot->value == NULL){
+    Value *newVal = talloc(sizeof(Value));
+    *newVal = *val;
+    // copy strings and symbols into buffers of the exact length
+    // (with a NUL byte after the text of strings too)
+    if (val->type == STR_TYPE || val->type == SYMBOL_TYPE){
+      size_t length = (val->type == STR_TYPE) ? (size_t)val->length : strlen(val->s);
+      newVal->s = talloc(length + 1);
+      memcpy(newVal->s, val->s, length);
+      newVal->s[length] = '\0';
+      newVal->inBuffer = 0;
+    }
+    slot->hash = hash;
+    slot->value = newVal;
+    shard->count++;
+  }
+  Value *pooled = slot->value;
+  if (concurrent){
+    pthread_mutex_unlock(&shard->lock);
+  }
+  return pooled;
+}
+
+
+// Returns the pooled Value that is equal to *val (same type and same
+// contents), adding a copy of *val to the pool if there is none yet.
+Value *internAtom(Value *val){
+  return lookUpOrAdd(val);
+}
+
+
+// Returns the pooled CONS_TYPE Value whose car is newCar and whose cdr is
+// newCdr, creating it if needed.
+Value *internCons(Value *newCar, Value *newCdr){
+  Value pair;
+  pair.type = CONS_TYPE;
+  (pair.c).car = newCar;
+  (pair.c).cdr = newCdr;
+  return lookUpOrAdd(&pair);
+}
+
+
+// Creates an empty literal pool.
+InternPool *internPoolCreate(){
+  InternPool *pool = malloc(sizeof(InternPool));
+  assert(pool != NULL && "Error (internPoolCreate): out of memory");
+  for (int i = 0; i < NUM_SHARDS; i++){
+    pool->shards[i].slots = NULL;
+    pool->shards[i].capacity = 0;
+    pool->shards[i].count = 0;
+    pthread_mutex_init(&pool->shards[i].lock, NULL);
+  }
+  pool->concurrent = 0;
+  return pool;
+}
+
+
+// Frees a pool created by internPoolCreate().
+void internPoolDestroy(InternPool *pool){
+  for (int i = 0; i < NUM_SHARDS; i++){
+    pthread_mutex_destroy(&pool->shards[i].lock);
+  }
+  free(pool);
+}
+
+
+// Returns the literal pool used on the calling thread.
+InternPool *activeInternPool(){
+  return currentPool;
+}
+
+
+// Makes the calling thread use pool.
+void setActiveInternPool(InternPool *pool){
+  currentPool = pool;
+}
+
+
+// Makes adding to pool safe from several threads at once (if on is
+// non-zero), or takes the locks out of lookups again.
+void setInternPoolConcurrent(InternPool *pool, int on){
+  pool->concurrent = on;
+}
@@ -0,0 +1,42 @@
+#include "value.h"
+
+#ifndef _INTERN
+#define _INTERN
+
+// Returns the pooled Value that is equal to *val (same type and same
+// contents), adding a copy of *val to the pool if there is none yet. Strings
+// and symbols are copied into a buffer of exactly the right length, so val->s
+// may point to a temporary buffer. Pooled Values are shared and must never be
+// modified.
+Value *internAtom(Value *val);
+
+// Returns the pooled CONS_TYPE Value whose car is newCar and whose cdr is
+// newCdr, creating it if needed. Both newCar and newCdr should themselves be
+// pooled, so that equal lists end up sharing the same cells.
+Value *internCons(Value *newCar, Value *newCdr);
+
+// The pooled Values live in the heap that was active when they were added
+// (see talloc.h), so each interpreter context has a pool of its own, made
+// active together with its heap.
+typedef struct InternPool InternPool;
+
+// Creates an empty literal pool.
+InternPool *internPoolCreate();
+
+// Frees a pool created by internPoolCreate(). The pooled Values go with
+// the heap they were talloc'd from.
+void internPoolDestroy(InternPool *pool);
+
+// Returns the literal pool used on the calling thread.
+InternPool *activeInternPool();
+
+// Makes the calling thread use pool.
+void setActiveInternPool(InternPool *pool);
+
+// Makes adding to pool safe from several threads at once (if on is
+// non-zero), e.g. for parsing the parts of a program in parallel (see
+// reader.h), at the cost of a lock per lookup; or makes it unsafe again
+// once those threads are done with it.
+void setInternPoolConcurrent(InternPool *pool, int on);
+
+#endif
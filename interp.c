@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <setjmp.h>
+#include "value.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "intern.h"
+#include "tokenizer.h"
+#include "parser.h"
+#include "output.h"
+#include "interpreter.h"
+#include "parallel.h"
+#include "interp.h"
+
+
+struct Interpreter {
+  Heap *heap;
+  InternPool *pool;
+  Frame *topFrame;
+};
+
+
+// Creates an interpreter context.
+Interpreter *interpCreate(){
+  Interpreter *interp = malloc(sizeof(Interpreter));
+  assert(interp != NULL && "Error (interpCreate): out of memory");
+  interp->heap = heapCreate();
+  interp->pool = internPoolCreate();
+  // the top frame is talloc'd from the new heap
+  Heap *outerHeap = activeHeap();
+  setActiveHeap(interp->heap);
+  interp->topFrame = makeTopFrame();
+  setActiveHeap(outerHeap);
+  return interp;
+}
+
+
+// Evaluates the program in source in interp, printing to out. While it
+// runs, the calling thread uses the heap, literal pool and output of interp,
+// and texit() jumps back here instead of exiting.
+int interpEvalString(Interpreter *interp, const char *source, FILE *out){
+  size_t length = strlen(source);
+  if (length == 0){
+    return 0;
+  }
+  Heap *outerHeap = activeHeap();
+  InternPool *outerPool = activeInternPool();
+  FILE *outerOutput = outputStream();
+  jmp_buf *outerTrap = exitTrap;
+  setActiveHeap(interp->heap);
+  setActiveInternPool(interp->pool);
+  setOutputStream(out);
+
+  jmp_buf trap;
+  exitTrap = &trap;
+  int status = setjmp(trap);
+  if (status == 0){
+    Value *tree = parse(tokenizeBuffer(source, length));
+    interpretIn(tree, interp->topFrame);
+  }
+  // (also after an error, since the futures are in the heap of interp)
+  settleFutures();
+  outputFlush();
+  fflush(out);
+
+  exitTrap = outerTrap;
+  setOutputStream(outerOutput);
+  setActiveInternPool(outerPool);
+  setActiveHeap(outerHeap);
+  return status;
+}
+
+
+// Evaluates the program in source in a temporary context whose top frame is
+// a child of the top frame of interp, printing to out.
+int interpEvalIsolated(Interpreter *interp, const char *source, FILE *out){
+  Interpreter script;
+  script.heap = heapCreate();
+  script.pool = internPoolCreate();
+  Heap *outerHeap = activeHeap();
+  setActiveHeap(script.heap);
+  script.topFrame = talloc(sizeof(Frame));
+  script.topFrame->bindings = makeNull();
+  script.topFrame->parent = interp->topFrame;
+  setActiveHeap(outerHeap);
+
+  // nothing in the heap of interp may point into the script's heap
+  Frame *outerSealed = setSealedFrame(interp->topFrame);
+  // the script's tasks are waited for apart from those of other scripts
+  TaskGroup group = {0};
+  TaskGroup *outerGroup = setTaskGroup(&group);
+  int status = interpEvalString(&script, source, out);
+  // futures that were never touched may still be running
+  waitForTaskGroup();
+  setTaskGroup(outerGroup);
+  setSealedFrame(outerSealed);
+
+  heapDestroy(script.heap);
+  internPoolDestroy(script.pool);
+  return status;
+}
+
+
+// Frees interp and all the memory it allocated.
+void interpDestroy(Interpreter *interp){
+  heapDestroy(interp->heap);
+  internPoolDestroy(interp->pool);
+  free(interp);
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#ifndef _INTERP
+#define _INTERP
+
+// An interpreter context owns everything one interpreter needs: a heap (see
+// talloc.h), a literal pool (see intern.h) and a top-level frame with the
+// primitives bound. Contexts share nothing that can change, so several of
+// them can run at the same time on different threads of one process; each
+// one must only be used by one thread at a time.
+typedef struct Interpreter Interpreter;
+
+// Creates an interpreter context.
+Interpreter *interpCreate();
+
+// Tokenizes, parses and evaluates the Scheme program in source, printing the
+// results and any error message to out. Definitions stay in the top-level
+// frame of interp for later calls. Returns 0, or the status of the error
+// that ended the program (which ends only this call, not the process).
+int interpEvalString(Interpreter *interp, const char *source, FILE *out);
+
+// Same as interpEvalString(), except that the program runs in a fresh
+// environment whose parent is the top-level frame of interp, with a heap and
+// literal pool of its own that are freed when it ends. Its definitions are
+// dropped, it cannot set! the bindings of interp, and interp is not changed,
+// so several threads can call this with the same interp at the same time.
+int interpEvalIsolated(Interpreter *interp, const char *source, FILE *out);
+
+// Frees interp and all the memory it allocated.
+void interpDestroy(Interpreter *interp);
+
+#endif
@@ -2,88 +2,584 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <stdint.h>
 #include "parser.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "talloc.h"
 #include "interpreter.h"
-
-
-void evaluationError(int type){
+#include "gc.h"
+#include "parallel.h"
+#include "parsecache.h"
+#include "output.h"
+#include "memo.h"
+#include "text.h"
+#include "intern.h"
+#include "counters.h"
+#include "stack.h"
+
+
+// The innermost place that catches errors raised on this thread, if any:
+// a guard or with-exception-handler being evaluated, a parallel task (whose
+// errors are reported by the thread that spawned it, in program order, see
+// EvalTask below) or a top-level form when continuing after errors.
+_Thread_local jmp_buf *errorTrap = NULL;
+
+// the error being raised on this thread: its type (see errorMessage())
+// and, for raise, the object raised
+_Thread_local int raisedType;
+_Thread_local Value *raisedObject;
+
+// the number of closure calls being evaluated on this thread, and the most
+// there may be (0 for no limit other than the stack, see stack.h). Where an
+// error is caught, the depth is set back to what it was when the trap was set.
+_Thread_local int callDepth = 0;
+int maxCallDepth = 0;
+
+
+// returns the message of an error type
+const char *errorMessage(int type){
   if (type == 0){
-    printf("Evaluation error (evalIf): if expression does not have 3 args\n");
+    return "Evaluation error (evalIf): if expression does not have 3 args";
   }
   else if (type == 1){
-    printf("Evaluation error (evalIf): condition of if expression does not evaluate to a Boolean\n");
+    return "Evaluation error (evalIf): condition of if expression does not evaluate to a Boolean";
   }
   else if (type == 2){
-    printf("Evaluation error (checkLetBindings): illegal let/let*/lectrec bindings list\n");
+    return "Evaluation error (checkLetBindings): illegal let/let*/lectrec bindings list";
   }
   else if (type == 3){
-    printf("Evaluation error (checkLetBody): illegal let/let*/lectrec body\n");
+    return "Evaluation error (checkLetBody): illegal let/let*/lectrec body";
   }
   else if (type == 4){
-    printf("Evaluation error (evalLet/evalLet*/evalLetrec): illegal let/let*/letrec arguments (not CONS_TYPE)\n");
+    return "Evaluation error (evalLet/evalLet*/evalLetrec): illegal let/let*/letrec arguments (not CONS_TYPE)";
   }
   else if (type == 5){
-    printf("Evaluation error (evalLet/evalLet*/evalLetrec): let/let*/letrec bindings has duplicate symbols\n");
+    return "Evaluation error (evalLet/evalLet*/evalLetrec): let/let*/letrec bindings has duplicate symbols";
   }
   else if (type == 6){
-    printf("Evaluation error (lookUpSymbol): unbound variable found\n");
+    return "Evaluation error (lookUpSymbol): unbound variable found";
   }
   else if (type == 7){
-    printf("Evaluation error (eval): not a recognized special form\n");
+    return "Evaluation error (eval): not a recognized special form";
   }
   else if (type == 8){
-    printf("Evaluation error: +, -, =, <, > only takes in real numbers\n");
+    return "Evaluation error: +, -, =, <, > only takes in real numbers";
   }
   else if (type == 9){
-    printf("Evaluation error (evalQuote): illegal quote arguments\n");
+    return "Evaluation error (evalQuote): illegal quote arguments";
   }
   else if (type == 10){
-    printf("Evaluation error (evalDefine/evalSet): illegal define/set! arguments\n");
+    return "Evaluation error (evalDefine/evalSet): illegal define/set! arguments";
   }
   else if (type == 11){
-    printf("Evaluation error (evalDefine): symbol already defined in frame\n");
+    return "Evaluation error (evalDefine): symbol already defined in frame";
   }
   else if (type == 12){
-    printf("Evaluation error (evalLambda): illegal lambda arguments\n");
+    return "Evaluation error (evalLambda): illegal lambda arguments";
   }
   else if (type == 13){
-    printf("Evaluation error (evalLambda): illegal lambda body\n");
+    return "Evaluation error (evalLambda): illegal lambda body";
   }
 
   else if (type == 14){
-    printf("Evaluation error (apply): first argument in combination is not a closure\n");
+    return "Evaluation error (apply): first argument in combination is not a closure";
   }
   else if (type == 15){
-    printf("Evaluation error (apply): number of actual arguments does not match with number of formal arguments\n");
+    return "Evaluation error (apply): number of actual arguments does not match with number of formal arguments";
   }
   else if (type == 16){
-    printf("Evaluation error: + only takes integers and reals\n");
+    return "Evaluation error: + only takes integers and reals";
   }
   else if (type == 17){
-    printf("Evaluation error: null? takes one argument\n");
+    return "Evaluation error: null? takes one argument";
   }
   else if (type == 18){
-    printf("Evaluation error: car takes one argument of type pair\n");
+    return "Evaluation error: car takes one argument of type pair";
   }
   else if (type == 19){
-    printf("Evaluation error: cdr takes one argument of type pair\n");
+    return "Evaluation error: cdr takes one argument of type pair";
   }
   else if (type == 20){
-    printf("Evaluation error: cons takes two arguments\n");
+    return "Evaluation error: cons takes two arguments";
   }
   else if (type == 21){
-    printf("Evaluation error: - takes >=1 arguments\n");
+    return "Evaluation error: - takes >=1 arguments";
+  }
+  else if (type == 22){
+    return "Evaluation error (evalPcall): pcall takes a function and its arguments";
+  }
+  else if (type == 23){
+    return "Evaluation error: future and touch take one argument";
+  }
+  else if (type == 24){
+    return "Evaluation error (raise): uncaught exception";
+  }
+  else if (type == 25){
+    return "Evaluation error (evalGuard): illegal guard arguments";
+  }
+  else if (type == 26){
+    return "Evaluation error: with-exception-handler takes a handler and a thunk";
+  }
+  else if (type == 27){
+    return "Evaluation error: raise takes one argument";
+  }
+  else if (type == 28){
+    return "Evaluation error (evalSet): cannot set! a binding of the shared top-level frame";
+  }
+  else if (type == 29){
+    return "Evaluation error (evalLoad): load takes one string naming a readable file";
+  }
+  else if (type == 30){
+    return "Evaluation error (primitiveDisplay): display takes one argument";
+  }
+  else if (type == 31){
+    return "Evaluation error (primitiveNewline): newline takes no arguments";
+  }
+  else if (type == 32){
+    return "Evaluation error (primitiveAppend): append takes lists, except for its last argument";
+  }
+  else if (type == 33){
+    return "Evaluation error (primitiveLength): length takes one proper list";
+  }
+  else if (type == 34){
+    return "Evaluation error (primitiveReverse): reverse takes one proper list";
+  }
+  else if (type == 35){
+    return "Evaluation error (primitiveListTail): list-tail takes a list and an index no larger than its length";
+  }
+  else if (type == 36){
+    return "Evaluation error: map and for-each take a procedure and lists";
+  }
+  else if (type == 37){
+    return "Evaluation error (primitiveFilter): filter takes a procedure and a proper list";
+  }
+  else if (type == 38){
+    return "Evaluation error (primitiveFoldLeft): fold-left takes a procedure, an initial value and lists";
+  }
+  else if (type == 39){
+    return "Evaluation error: member and assoc take a value and a list (of lists, for assoc)";
+  }
+  else if (type == 40){
+    return "Evaluation error: eq?, eqv? and equal? take two arguments";
+  }
+  else if (type == 41){
+    return "Evaluation error (primitiveEqualHash): equal-hash takes one argument";
+  }
+  else if (type == 42){
+    return "Evaluation error (primitiveMemoize): memoize takes a closure and an optional positive capacity";
+  }
+  else if (type == 43){
+    return "Evaluation error (evalDefineMemoized): define-memoized takes a name with parameters and a body";
+  }
+  else if (type == 44){
+    return "Evaluation error (primitiveMemoizeStats): memoize-stats takes a memoized procedure";
+  }
+  else if (type == 45){
+    return "Evaluation error (primitiveStringLength): string-length takes one string";
+  }
+  else if (type == 46){
+    return "Evaluation error (primitiveStringAppend): string-append takes strings, whose text must fit in a string";
+  }
+  else if (type == 47){
+    return "Evaluation error (primitiveSubstring): substring takes a string and indices start <= end <= its length";
+  }
+  else if (type == 48){
+    return "Evaluation error (primitiveStringEqual): string=? takes one or more strings";
+  }
+  else if (type == 49){
+    return "Evaluation error (primitiveStringToSymbol): string->symbol takes one string";
+  }
+  else if (type == 50){
+    return "Evaluation error (primitiveNumberToString): number->string takes one number";
+  }
+  else if (type == 51){
+    return "Evaluation error (eval): stack overflow, the recursion is too deep (see --stack-size and --max-depth)";
+  }
+  else if (type == 52){
+    return "Evaluation error (evalLoad): the file to load has a syntax error";
   }
   else{
-    printf("Evaluation error\n");
+    return "Evaluation error";
+  }
+}
+
+
+// prints the message of an error (followed by the
+// object raised, for raise) to the output
+void printError(int type, Value *object){
+  outputString(errorMessage(type));
+  if (object != NULL){
+    outputChar(' ');
+    printTree(object);
+  }
+  outputChar('\n');
+  outputFlush();
+}
+
+
+// Raises an error: jumps to errorTrap if it is set, and otherwise
+// prints the error and exits.
+void raiseError(int type, Value *object){
+  raisedType = type;
+  raisedObject = object;
+  if (errorTrap != NULL){
+    longjmp(*errorTrap, 1);
   }
+  printError(type, object);
   texit(1);
 }
 
 
+void evaluationError(int type){
+  raiseError(type, NULL);
+}
+
+
+// returns the object a guard or an exception handler receives for an
+// error: the object raised, or else a string holding the error message
+Value *errorCondition(int type, Value *object){
+  if (object != NULL){
+    return object;
+  }
+  const char *message = errorMessage(type);
+  return makeString(message, strlen(message));
+}
+
+
+// Immutable values that evaluation produces over and over
+// (#t, #f, the void value and small integers) are shared
+// instead of being talloc'd for every result. Like literals,
+// shared Values must never be modified.
+#define SMALL_INT_MIN -128
+#define SMALL_INT_MAX 1023
+
+Value trueValue = { .type = BOOL_TYPE, .i = 1 };
+Value falseValue = { .type = BOOL_TYPE, .i = 0 };
+Value voidValue = { .type = VOID_TYPE };
+Value smallInts[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+pthread_once_t smallIntsOnce = PTHREAD_ONCE_INIT;
+
+
+// fills in the table of shared small integers (once per process)
+void initSmallInts(){
+  for (int n = SMALL_INT_MIN; n <= SMALL_INT_MAX; n++){
+    smallInts[n - SMALL_INT_MIN].type = INT_TYPE;
+    smallInts[n - SMALL_INT_MIN].i = n;
+  }
+}
+
+
+// returns a BOOL_TYPE Value (#t if b is non-zero)
+Value *makeBool(int b){
+  if (b){
+    return &trueValue;
+  }
+  return &falseValue;
+}
+
+
+// returns a VOID_TYPE Value
+Value *makeVoid(){
+  return &voidValue;
+}
+
+
+// returns an INT_TYPE Value holding n
+Value *makeInt(int n){
+  if (n >= SMALL_INT_MIN && n <= SMALL_INT_MAX){
+    return &smallInts[n - SMALL_INT_MIN];
+  }
+  Value *newVal = talloc(sizeof(Value));
+  newVal->type = INT_TYPE;
+  newVal->i = n;
+  return newVal;
+}
+
+
+// returns a DOUBLE_TYPE Value holding d
+Value *makeDouble(double d){
+  Value *newVal = talloc(sizeof(Value));
+  newVal->type = DOUBLE_TYPE;
+  newVal->d = d;
+  return newVal;
+}
+
+
+// List values. A list is kept wrapped in a one-item list (see evalQuote()),
+// so the value of (quote (1 2)) is a cell whose car is the first cell of
+// (1 2). The empty list is a cell with a NULL_TYPE car (and cdr), and a list
+// can end in such a cell as well as in the NULL_TYPE Value. Inside a list,
+// an item that is a list is stored without the wrapper.
+
+// returns non-zero if cell is a cell of a list holding an item, as opposed
+// to the end of the list
+int isItemCell(Value *cell){
+  return cell->type == CONS_TYPE && (cell->c).car->type != NULL_TYPE;
+}
+
+
+// returns the first cell of the list value, or the NULL_TYPE Value if it is
+// empty; raises the error type if value is not a list
+Value *listCells(Value *value, int type){
+  if (value->type != CONS_TYPE || (value->c).car->type != CONS_TYPE){
+    evaluationError(type);
+  }
+  Value *cells = (value->c).car;
+  return isItemCell(cells) ? cells : makeNull();
+}
+
+
+// returns the number of items of the list whose first cell is cells,
+// or -1 if it does not end in the empty list
+int countItems(Value *cells){
+  int count = 0;
+  while (isItemCell(cells)){
+    count++;
+    cells = (cells->c).cdr;
+  }
+  return (cells->type == NULL_TYPE || cells->type == CONS_TYPE) ? count : -1;
+}
+
+
+// returns the value of a list item (wrapping a list)
+Value *itemValue(Value *item){
+  if (item->type == CONS_TYPE){
+    return cons(item, makeNull());
+  }
+  return item;
+}
+
+
+// returns the list item that stores value (unwrapping a list, like cons)
+Value *valueItem(Value *value){
+  if (value->type == CONS_TYPE){
+    return (value->c).car;
+  }
+  return value;
+}
+
+
+// Returns a new list value of count items, whose cells (and wrapper) are
+// allocated as one block. The cells are linked in order and hold the
+// empty list until the caller fills them in: cells[i] holds item i.
+Value *newList(int count, Value **cells){
+  // (the empty list takes a cell too)
+  Value *block = talloc(((count == 0) ? 2 : count + 1) * sizeof(Value));
+  Value *first = block + 1;
+  if (count == 0){
+    first->type = CONS_TYPE;
+    (first->c).car = makeNull();
+    (first->c).cdr = makeNull();
+  }
+  for (int i = 0; i < count; i++){
+    first[i].type = CONS_TYPE;
+    first[i].c.car = makeNull();
+    first[i].c.cdr = (i + 1 < count) ? &first[i + 1] : makeNull();
+  }
+  block->type = CONS_TYPE;
+  (block->c).car = first;
+  (block->c).cdr = makeNull();
+  *cells = first;
+  return block;
+}
+
+
+// returns the list value whose first cell is cells (possibly the end of
+// a list), sharing the cells
+Value *wrapCells(Value *cells){
+  if (!isItemCell(cells)){
+    Value *empty;
+    return newList(0, &empty);
+  }
+  return cons(cells, makeNull());
+}
+
+
+// returns non-zero if the list item a is the empty list
+int isEmptyItem(Value *a){
+  return a->type == NULL_TYPE || (a->type == CONS_TYPE && !isItemCell(a));
+}
+
+
+// returns non-zero if the list items a and b are the same in the sense of
+// eq?: the same object, or both the empty list, or symbols, integers,
+// booleans or void values that hold the same (Values of these types are
+// copied freely, e.g. by makeInt() and the literal pool)
+int itemsEq(Value *a, Value *b){
+  if (a == b){
+    return 1;
+  }
+  if (isEmptyItem(a) || isEmptyItem(b)){
+    return isEmptyItem(a) && isEmptyItem(b);
+  }
+  if (a->type != b->type){
+    return 0;
+  }
+  switch (a->type){
+    case INT_TYPE:
+    case BOOL_TYPE:
+      return a->i == b->i;
+    case SYMBOL_TYPE:
+      return a->s == b->s || strcmp(a->s, b->s) == 0;
+    case VOID_TYPE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+
+// returns non-zero if the list items a and b are the same in the sense of
+// eqv?: like eq?, but doubles with the same bits are the same too
+int itemsEqv(Value *a, Value *b){
+  if (a->type == DOUBLE_TYPE && b->type == DOUBLE_TYPE){
+    return memcmp(&a->d, &b->d, sizeof(double)) == 0;
+  }
+  return itemsEq(a, b);
+}
+
+
+// returns non-zero if the atoms a and b are equal in the sense of equal?:
+// eqv?, or strings with the same text
+int atomsEqual(Value *a, Value *b){
+  if (a->type == STR_TYPE && b->type == STR_TYPE){
+    return a == b || stringsEqual(a, b);
+  }
+  return itemsEqv(a, b);
+}
+
+
+// returns the next event of walk, leaving out the empty list
+// that a list may end in (see isItemCell())
+ListEvent nextItemEvent(ListWalk *walk, Value **value){
+  ListEvent event = listWalkNext(walk, value);
+  while (event == LIST_ITEM && (*value)->type == NULL_TYPE){
+    event = listWalkNext(walk, value);
+  }
+  return event;
+}
+
+
+// returns non-zero if the list items a and b are equal, comparing lists
+// item by item (what equal? does)
+int itemsEqual(Value *a, Value *b){
+  if (a == b){
+    return 1;
+  }
+  if (isEmptyItem(a) || isEmptyItem(b) || a->type != CONS_TYPE || b->type != CONS_TYPE){
+    return atomsEqual(a, b);
+  }
+  // the lists are walked side by side, skipping any part of them
+  // that is shared (which literal lists often are, see intern.h)
+  ListWalk walkA;
+  ListWalk walkB;
+  listWalkStart(&walkA, a);
+  listWalkStart(&walkB, b);
+  int equal = 1;
+  while (equal){
+    Value *restA = listWalkRest(&walkA);
+    if (restA != NULL && restA == listWalkRest(&walkB)){
+      listWalkSkipRest(&walkA);
+      listWalkSkipRest(&walkB);
+    }
+    Value *valueA;
+    Value *valueB;
+    ListEvent event = nextItemEvent(&walkA, &valueA);
+    if (event != nextItemEvent(&walkB, &valueB)){
+      equal = 0;
+    }
+    else if (event == LIST_ITEM || event == LIST_TAIL){
+      equal = atomsEqual(valueA, valueB);
+    }
+    else if (event == LIST_END){
+      break;
+    }
+  }
+  listWalkEnd(&walkA);
+  listWalkEnd(&walkB);
+  return equal;
+}
+
+
+// mixes the 64 bits of word into hash
+uint64_t mixHash(uint64_t hash, uint64_t word){
+  hash ^= word;
+  hash *= 0x100000001b3ULL;
+  return hash ^ (hash >> 29);
+}
+
+
+// returns a hash of the atom a that is the same for atoms that are
+// equal in the sense of equal?
+uint64_t atomHash(Value *a){
+  uint64_t hash = mixHash(14695981039346656037ULL, a->type);
+  switch (a->type){
+    case INT_TYPE:
+    case BOOL_TYPE:
+      return mixHash(hash, (uint64_t)(int64_t)a->i);
+    case DOUBLE_TYPE: {
+      uint64_t bits;
+      memcpy(&bits, &a->d, sizeof(bits));
+      return mixHash(hash, bits);
+    }
+    case SYMBOL_TYPE:
+    case STR_TYPE: {
+      // the text is hashed a word at a time
+      size_t length = (a->type == STR_TYPE) ? (size_t)a->length : strlen(a->s);
+      size_t i = 0;
+      for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)){
+        uint64_t word;
+        memcpy(&word, a->s + i, sizeof(word));
+        hash = mixHash(hash, word);
+      }
+      uint64_t last = 0;
+      memcpy(&last, a->s + i, length - i);
+      return mixHash(mixHash(hash, last), length);
+    }
+    case VOID_TYPE:
+      return hash;
+    default:
+      return mixHash(hash, (uint64_t)(uintptr_t)a);
+  }
+}
+
+
+// Returns a hash of the value that is the same for values that are equal
+// in the sense of equal? (what equal-hash returns).
+uint64_t valueHash(Value *value){
+  Value *item = valueItem(value);
+  if (isEmptyItem(item)){
+    return mixHash(14695981039346656037ULL, NULL_TYPE);
+  }
+  if (item->type != CONS_TYPE){
+    return atomHash(item);
+  }
+  uint64_t hash = mixHash(14695981039346656037ULL, CONS_TYPE);
+  ListWalk walk;
+  listWalkStart(&walk, item);
+  Value *atom;
+  ListEvent event;
+  while ((event = nextItemEvent(&walk, &atom)) != LIST_END){
+    hash = mixHash(hash, event);
+    if (event == LIST_ITEM || event == LIST_TAIL){
+      hash = mixHash(hash, atomHash(atom));
+    }
+  }
+  listWalkEnd(&walk);
+  return hash;
+}
+
+
+// Returns non-zero if the values a and b are equal in the sense of equal?.
+int valuesEqual(Value *a, Value *b){
+  return itemsEqual(valueItem(a), valueItem(b));
+}
+
+
+
 // for the Scheme primitive function "+"
 // (but this version does not deal with complex numbers)
 // takes in a list of reals (double/integer)
@@ -94,11 +590,8 @@ Value *primitiveAdd(Value *args) {
   // args should be a proper list
   assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveAdd): args is not a list");
   // if args is empty, return 0 (int)
-  Value *returnVal = talloc(sizeof(Value));
   if (args->type == NULL_TYPE){
-    returnVal->type = INT_TYPE;
-    returnVal->i = 0;
-    return returnVal;
+    return makeInt(0);
   }
   double sum = 0;
   int hasDouble = 0; // record the type (0 = not double)
@@ -121,15 +614,10 @@ Value *primitiveAdd(Value *args) {
     curArg = cdr(curArg);
   }
   if (!hasDouble){
-    returnVal->type = INT_TYPE;
     // typecast sum to int if args only have integers
-    returnVal->i = (int) sum;
+    return makeInt((int) sum);
   }
-  else{
-    returnVal->type = DOUBLE_TYPE;
-    returnVal->d = sum;
-  }
-  return returnVal;
+  return makeDouble(sum);
 }
 
 
@@ -145,22 +633,17 @@ Value *primitiveCheckNull(Value *args){
     evaluationError(17);
   }
 
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = BOOL_TYPE;
   // argument is not a list
   if ((car(args))->type != CONS_TYPE){
-    returnVal->i = 0;
-    return returnVal;
+    return makeBool(0);
   }
   Value *list = car(car(args));
   // argument is an non-empty list
   if (!((car(list))->type == NULL_TYPE && (cdr(list))->type == NULL_TYPE)){
-    returnVal->i = 0;
-    return returnVal;
+    return makeBool(0);
   }
   // argument is an empty list
-  returnVal->i = 1;
-  return returnVal;
+  return makeBool(1);
 }
 
 
@@ -178,13 +661,13 @@ Value *primitiveCar(Value *args){
     evaluationError(18);
   }
   Value *list = car(car(args));
-  // argument is an empty list
-  if ((car(list))->type == NULL_TYPE && (cdr(list))->type == NULL_TYPE){
+  // argument is not a list, or an empty list
+  if (list->type != CONS_TYPE || !isItemCell(list)){
     evaluationError(18);
   }
   // argument is not an empty list - then return the car
-  // consing with a NULL cell is for printing formatting
-  return cons(car(list), makeNull());
+  // (wrapped if it is a list, see itemValue())
+  return itemValue(car(list));
 }
 
 
@@ -202,8 +685,8 @@ Value *primitiveCdr(Value *args){
     evaluationError(19);
   }
   Value *list = car(car(args));
-  // argument is an empty list
-  if ((car(list))->type == NULL_TYPE && (cdr(list))->type == NULL_TYPE){
+  // argument is not a list, or an empty list
+  if (list->type != CONS_TYPE || !isItemCell(list)){
     evaluationError(19);
   }
   // argument is not an empty list - then return the cdr
@@ -249,11 +732,8 @@ Value *primitiveEqual(Value *args) {
   // args should be a proper list
   assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveEqual): args is not a list");
   // if args is empty, return true
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = BOOL_TYPE;
   if (args->type == NULL_TYPE){
-    returnVal->i = 1;
-    return returnVal;
+    return makeBool(1);
   }
 
   Value *firstNum = car(args);
@@ -264,8 +744,7 @@ Value *primitiveEqual(Value *args) {
   }
   // if there is only one number, return true
   if (length(args) < 2){
-    returnVal->i = 1;
-    return returnVal;
+    return makeBool(1);
   }
   // get the first number's value for comparison
   if (firstNum->type == DOUBLE_TYPE){
@@ -292,14 +771,12 @@ Value *primitiveEqual(Value *args) {
     }
     // if current number is not equal to the first number, return false
     if (curNumVal != firstNumVal){
-      returnVal->i = 0;
-      return returnVal;
+      return makeBool(0);
     }
     curArg = cdr(curArg);
   }
   // if all other numbers are equal to the first number, return true
-  returnVal->i = 1;
-  return returnVal;
+  return makeBool(1);
 }
 
 
@@ -312,7 +789,6 @@ Value *primitiveEqual(Value *args) {
 Value *primitiveMinus(Value *args) {
   // args should be a proper list
   assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveMinus): args is not a list");
-  Value *returnVal = talloc(sizeof(Value));
   // must take >=1 arguments
   if (args->type == NULL_TYPE){
     evaluationError(21);
@@ -337,14 +813,9 @@ Value *primitiveMinus(Value *args) {
   if (length(args) == 1){
     // return the negative of the first number
     if (!hasDouble){
-      returnVal->type = INT_TYPE;
-      returnVal->i = (int) (firstNumVal*(-1)); // cast back to an integer
-    }
-    else{
-      returnVal->type = DOUBLE_TYPE;
-      returnVal->d = firstNumVal*(-1);
+      return makeInt((int) (firstNumVal*(-1))); // cast back to an integer
     }
-    return returnVal;
+    return makeDouble(firstNumVal*(-1));
   }
   // multiple numbers: calculate the sum of all other
   // numbers and then its difference with the first num
@@ -360,14 +831,9 @@ Value *primitiveMinus(Value *args) {
     }
 
     if (!hasDouble){
-      returnVal->type = INT_TYPE;
-      returnVal->i = (int) (firstNumVal - sumOtherVal);
-    }
-    else{
-      returnVal->type = DOUBLE_TYPE;
-      returnVal->d = firstNumVal - sumOtherVal;
+      return makeInt((int) (firstNumVal - sumOtherVal));
     }
-    return returnVal;
+    return makeDouble(firstNumVal - sumOtherVal);
   }
 }
 
@@ -380,11 +846,8 @@ Value *primitiveLessThan(Value *args) {
   // args should be a proper list
   assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveLessThan): args is not a list");
   // if args is empty, return true
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = BOOL_TYPE;
   if (args->type == NULL_TYPE){
-    returnVal->i = 1;
-    return returnVal;
+    return makeBool(1);
   }
 
   Value *firstNum = car(args);
@@ -395,8 +858,7 @@ Value *primitiveLessThan(Value *args) {
   }
   // if there is only one number, return true
   if (length(args) < 2){
-    returnVal->i = 1;
-    return returnVal;
+    return makeBool(1);
   }
   // get the first number's value for comparison
   if (firstNum->type == DOUBLE_TYPE){
@@ -424,130 +886,1255 @@ Value *primitiveLessThan(Value *args) {
     }
     // if current number is not greater than the previous number, return false
     if (!(curNumVal > prevNumVal)){
-      returnVal->i = 0;
-      return returnVal;
+      return makeBool(0);
     }
     prevNumVal = curNumVal;
     curArg = cdr(curArg);
   }
-  returnVal->i = 1;
-  return returnVal;
+  return makeBool(1);
+}
+
+
+// for the Scheme primitive function ">" 
+// takes in a list of reals (double/integer)
+// and return true if its arguments are monotonically
+// decreasing, i.e., each argument is greater than the preceding ones
+Value *primitiveGreaterThan(Value *args) {
+  // args should be a proper list
+  assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveGreaterThan): args is not a list");
+  // if args is empty, return true
+  if (args->type == NULL_TYPE){
+    return makeBool(1);
+  }
+
+  Value *firstNum = car(args);
+  double firstNumVal;
+  // check the first number's type is correct
+  if ((firstNum->type != DOUBLE_TYPE) && (firstNum->type != INT_TYPE)){
+    evaluationError(8);
+  }
+  // if there is only one number, return true
+  if (length(args) < 2){
+    return makeBool(1);
+  }
+  // get the first number's value for comparison
+  if (firstNum->type == DOUBLE_TYPE){
+    firstNumVal = firstNum->d;
+  }
+  else{
+    firstNumVal = (firstNum->i)*1.0; // cast integer to double
+  }
+  // check if each argument is less than the preceding one
+  Value *curArg = cdr(args);
+  double prevNumVal = firstNumVal;
+  while (curArg->type != NULL_TYPE){
+    Value *curNum = car(curArg);
+    double curNumVal;
+    // check the current number's type is correct
+    if (curNum->type != DOUBLE_TYPE && curNum->type != INT_TYPE){
+      evaluationError(8);
+    }
+    // get the current number's value
+    if (curNum->type == DOUBLE_TYPE){
+      curNumVal = curNum->d;
+    }
+    else{
+      curNumVal = (curNum->i)*1.0;
+    }
+    // if current number is not smaller than the previous number, return false
+    if (!(curNumVal < prevNumVal)){
+      return makeBool(0);
+    }
+    prevNumVal = curNumVal;
+    curArg = cdr(curArg);
+  }
+  return makeBool(1);
+}
+
+
+// (raise obj) raises obj as an error, to be caught by
+// guard or with-exception-handler
+Value *primitiveRaise(Value *args){
+  if (length(args) != 1){
+    evaluationError(27);
+  }
+  raiseError(24, car(args));
+  return NULL;
+}
+
+
+// for the Scheme function "display"
+// prints its one argument (strings without quotes)
+Value *primitiveDisplay(Value *args){
+  if (length(args) != 1){
+    evaluationError(30);
+  }
+  displayValue(car(args));
+  return makeVoid();
+}
+
+
+// for the Scheme function "newline"
+Value *primitiveNewline(Value *args){
+  if (args->type != NULL_TYPE){
+    evaluationError(31);
+  }
+  outputChar('\n');
+  return makeVoid();
+}
+
+
+Value *applyArray(Value *function, Value **args, int count);
+
+
+// for the Scheme function "list"
+// returns a new list of its arguments (the argument list itself
+// is released by evalCombination(), so it can't be returned)
+Value *primitiveList(Value *args){
+  Value *cells;
+  Value *list = newList(length(args), &cells);
+  for (Value *curArg = args; curArg->type != NULL_TYPE; curArg = cdr(curArg)){
+    (cells->c).car = valueItem(car(curArg));
+    cells++;
+  }
+  return list;
+}
+
+
+// for the Scheme function "append"
+// returns a new list of the items of all its arguments but the last,
+// followed by the last one, which is shared (and may be any value)
+Value *primitiveAppend(Value *args){
+  if (args->type == NULL_TYPE){
+    Value *cells;
+    return newList(0, &cells);
+  }
+  int count = 0;
+  Value *curArg = args;
+  while (cdr(curArg)->type != NULL_TYPE){
+    int listCount = countItems(listCells(car(curArg), 32));
+    if (listCount < 0){
+      evaluationError(32);
+    }
+    count += listCount;
+    curArg = cdr(curArg);
+  }
+  Value *last = car(curArg);
+  if (count == 0){
+    return last;
+  }
+  Value *cells;
+  Value *list = newList(count, &cells);
+  for (curArg = args; cdr(curArg)->type != NULL_TYPE; curArg = cdr(curArg)){
+    for (Value *cell = listCells(car(curArg), 32); isItemCell(cell); cell = (cell->c).cdr){
+      (cells->c).car = (cell->c).car;
+      cells++;
+    }
+  }
+  // the last cell continues with the last argument
+  Value *tail = valueItem(last);
+  cells[-1].c.cdr = (tail->type == CONS_TYPE && !isItemCell(tail)) ? makeNull() : tail;
+  return list;
+}
+
+
+// for the Scheme function "length"
+Value *primitiveLength(Value *args){
+  if (length(args) != 1){
+    evaluationError(33);
+  }
+  int count = countItems(listCells(car(args), 33));
+  if (count < 0){
+    evaluationError(33);
+  }
+  return makeInt(count);
+}
+
+
+// for the Scheme function "reverse"
+// returns a new list of the items of its argument in reverse order
+Value *primitiveReverse(Value *args){
+  if (length(args) != 1){
+    evaluationError(34);
+  }
+  Value *cell = listCells(car(args), 34);
+  int count = countItems(cell);
+  if (count < 0){
+    evaluationError(34);
+  }
+  Value *cells;
+  Value *list = newList(count, &cells);
+  for (int i = count - 1; i >= 0; i--){
+    cells[i].c.car = (cell->c).car;
+    cell = (cell->c).cdr;
+  }
+  return list;
+}
+
+
+// for the Scheme function "list-tail"
+// (list-tail l k) returns the list l without its first k items,
+// sharing its cells
+Value *primitiveListTail(Value *args){
+  if (length(args) != 2 || car(cdr(args))->type != INT_TYPE){
+    evaluationError(35);
+  }
+  Value *cell = listCells(car(args), 35);
+  int k = car(cdr(args))->i;
+  if (k < 0){
+    evaluationError(35);
+  }
+  for (int i = 0; i < k; i++){
+    if (!isItemCell(cell)){
+      evaluationError(35);
+    }
+    cell = (cell->c).cdr;
+  }
+  return wrapCells(cell);
+}
+
+
+// the most arguments that mapLists() and applyArray() pass without
+// allocating
+#define MAX_ARGS_ON_STACK 8
+
+
+// Calls function with the items of lists, one from each in turn, until the
+// shortest list ends (as map, for-each and fold-left do). With results
+// non-NULL, the value of each call is stored in the list it points to (of
+// the length of the shortest list). With an accumulator, the value of the
+// previous call (or *accumulator at first) is passed as the first argument,
+// and *accumulator is set to the value of the last call.
+void mapLists(Value *function, Value *lists, int type, Value *results, Value **accumulator){
+  int numLists = length(lists);
+  int numArgs = numLists + (accumulator != NULL);
+  Value *cellsOnStack[MAX_ARGS_ON_STACK];
+  Value *argsOnStack[MAX_ARGS_ON_STACK];
+  int onStack = numArgs <= MAX_ARGS_ON_STACK;
+  Value **cells = onStack ? cellsOnStack : talloc(numLists * sizeof(Value *));
+  Value **args = onStack ? argsOnStack : talloc(numArgs * sizeof(Value *));
+  for (int i = 0; i < numLists; i++){
+    cells[i] = listCells(car(lists), type);
+    lists = cdr(lists);
+  }
+  Value *result = (accumulator != NULL) ? *accumulator : NULL;
+  while (1){
+    for (int i = 0; i < numLists; i++){
+      if (!isItemCell(cells[i])){
+        if (accumulator != NULL){
+          *accumulator = result;
+        }
+        if (!onStack){
+          trelease(cells, numLists * sizeof(Value *));
+          trelease(args, numArgs * sizeof(Value *));
+        }
+        return;
+      }
+    }
+    if (accumulator != NULL){
+      args[0] = result;
+    }
+    for (int i = 0; i < numLists; i++){
+      args[numArgs - numLists + i] = itemValue((cells[i]->c).car);
+      cells[i] = (cells[i]->c).cdr;
+    }
+    result = applyArray(function, args, numArgs);
+    if (results != NULL){
+      // (results was allocated before this call's safepoints)
+      Value *item = valueItem(result);
+      gcWriteBarrier(item);
+      (results->c).car = item;
+      results = (results->c).cdr;
+    }
+  }
+}
+
+
+// returns the length of the shortest of lists (list values)
+int shortestLength(Value *lists, int type){
+  int shortest = -1;
+  for (; lists->type != NULL_TYPE; lists = cdr(lists)){
+    int count = 0;
+    for (Value *cell = listCells(car(lists), type); isItemCell(cell); cell = (cell->c).cdr){
+      count++;
+    }
+    if (shortest < 0 || count < shortest){
+      shortest = count;
+    }
+  }
+  return shortest;
+}
+
+
+// for the Scheme function "map"
+// (map f l1 l2 ...) returns the list of the values of f applied to
+// the items of the lists in turn, as long as the shortest list
+Value *primitiveMap(Value *args){
+  if (length(args) < 2){
+    evaluationError(36);
+  }
+  Value *cells;
+  Value *list = newList(shortestLength(cdr(args), 36), &cells);
+  mapLists(car(args), cdr(args), 36, cells, NULL);
+  return list;
+}
+
+
+// for the Scheme function "for-each"
+// like map, but only for the effects of the calls
+Value *primitiveForEach(Value *args){
+  if (length(args) < 2){
+    evaluationError(36);
+  }
+  mapLists(car(args), cdr(args), 36, NULL, NULL);
+  return makeVoid();
+}
+
+
+// for the Scheme function "fold-left"
+// (fold-left f init l1 l2 ...) calls f with init and the first items
+// of the lists, then with that value and the next items, and so on,
+// and returns the value of the last call (or init)
+Value *primitiveFoldLeft(Value *args){
+  if (length(args) < 3){
+    evaluationError(38);
+  }
+  Value *accumulator = car(cdr(args));
+  mapLists(car(args), cdr(cdr(args)), 38, NULL, &accumulator);
+  return accumulator;
+}
+
+
+// for the Scheme function "filter"
+// (filter pred l) returns a new list of the items of l
+// for which pred does not return #f, in order
+Value *primitiveFilter(Value *args){
+  if (length(args) != 2){
+    evaluationError(37);
+  }
+  Value *function = car(args);
+  Value *cell = listCells(car(cdr(args)), 37);
+  int count = countItems(cell);
+  if (count < 0){
+    evaluationError(37);
+  }
+  // the items kept so far
+  Value **kept = talloc((count + 1) * sizeof(Value *));
+  memset(kept, 0, (count + 1) * sizeof(Value *));
+  int numKept = 0;
+  for (; isItemCell(cell); cell = (cell->c).cdr){
+    Value *item = (cell->c).car;
+    Value *arg = itemValue(item);
+    Value *keep = applyArray(function, &arg, 1);
+    if (!(keep->type == BOOL_TYPE && keep->i == 0)){
+      gcWriteBarrier(item);
+      kept[numKept] = item;
+      numKept++;
+    }
+  }
+  Value *cells;
+  Value *list = newList(numKept, &cells);
+  for (int i = 0; i < numKept; i++){
+    cells[i].c.car = kept[i];
+  }
+  trelease(kept, (count + 1) * sizeof(Value *));
+  return list;
+}
+
+
+// for the Scheme functions "eq?", "eqv?" and "equal?": returns
+// whether the two values in args are the same by the given test
+Value *compareTwo(Value *args, int (*same)(Value *, Value *)){
+  if (length(args) != 2){
+    evaluationError(40);
+  }
+  return makeBool(same(valueItem(car(args)), valueItem(car(cdr(args)))));
+}
+
+
+Value *primitiveEq(Value *args){
+  return compareTwo(args, itemsEq);
+}
+
+
+Value *primitiveEqv(Value *args){
+  return compareTwo(args, itemsEqv);
+}
+
+
+Value *primitiveEqualP(Value *args){
+  return compareTwo(args, itemsEqual);
+}
+
+
+// for the Scheme function "equal-hash"
+// returns a non-negative integer that is the same for equal? values
+Value *primitiveEqualHash(Value *args){
+  if (length(args) != 1){
+    evaluationError(41);
+  }
+  return makeInt((int)(valueHash(car(args)) & 0x7fffffff));
+}
+
+
+// for the Scheme function "member"
+// (member x l) returns the first tail of l whose first item
+// is equal to x (in the sense of equal?), or #f
+Value *primitiveMember(Value *args){
+  if (length(args) != 2){
+    evaluationError(39);
+  }
+  Value *item = valueItem(car(args));
+  for (Value *cell = listCells(car(cdr(args)), 39); isItemCell(cell); cell = (cell->c).cdr){
+    if (itemsEqual(item, (cell->c).car)){
+      return cons(cell, makeNull());
+    }
+  }
+  return makeBool(0);
+}
+
+
+// for the Scheme function "assoc"
+// (assoc x l) returns the first item of l (a list of pairs) whose car
+// is equal to x (in the sense of equal?), or #f
+Value *primitiveAssoc(Value *args){
+  if (length(args) != 2){
+    evaluationError(39);
+  }
+  Value *key = valueItem(car(args));
+  for (Value *cell = listCells(car(cdr(args)), 39); isItemCell(cell); cell = (cell->c).cdr){
+    Value *pair = (cell->c).car;
+    if (!isItemCell(pair)){
+      evaluationError(39);
+    }
+    if (itemsEqual(key, (pair->c).car)){
+      return cons(pair, makeNull());
+    }
+  }
+  return makeBool(0);
+}
+
+
+// the capacity of a memo unless the program chooses one
+#define DEFAULT_MEMO_CAPACITY 1024
+
+// returns a copy of the closure function whose results are cached in a
+// memo of capacity entries (see memo.h)
+Value *memoizedClosure(Value *function, int capacity){
+  Value *fn = talloc(sizeof(Value));
+  fn->type = CLOSURE_TYPE;
+  fn->closure = talloc(sizeof(Closure));
+  *(fn->closure) = *(function->closure);
+  fn->closure->memo = memoCreate(capacity);
+  fn->closure->memoCapacity = capacity;
+  return fn;
+}
+
+
+// for the Scheme function "memoize"
+// (memoize f) returns a procedure that computes what the closure f does,
+// but keeps the results of the last 1024 calls (or of capacity calls, for
+// (memoize f capacity)) and returns the kept result when called again with
+// arguments that are equal? to those of an earlier call
+Value *primitiveMemoize(Value *args){
+  int count = length(args);
+  if (count < 1 || count > 2 || car(args)->type != CLOSURE_TYPE){
+    evaluationError(42);
+  }
+  int capacity = DEFAULT_MEMO_CAPACITY;
+  if (count == 2){
+    Value *capacityValue = car(cdr(args));
+    if (capacityValue->type != INT_TYPE || capacityValue->i <= 0){
+      evaluationError(42);
+    }
+    capacity = capacityValue->i;
+  }
+  return memoizedClosure(car(args), capacity);
+}
+
+
+// for the Scheme function "memoize-stats"
+// (memoize-stats f) returns the list (hits misses size) of the memoized
+// procedure f: the calls answered from its cache, the calls computed, and
+// the number of results kept
+Value *primitiveMemoizeStats(Value *args){
+  if (length(args) != 1 || car(args)->type != CLOSURE_TYPE ||
+      car(args)->closure->memoCapacity == 0){
+    evaluationError(44);
+  }
+  long hits = 0;
+  long misses = 0;
+  int size = 0;
+  if (car(args)->closure->memo != NULL){
+    memoStats(car(args)->closure->memo, &hits, &misses, &size);
+  }
+  Value *cells;
+  Value *list = newList(3, &cells);
+  (cells[0].c).car = makeInt((int)hits);
+  (cells[1].c).car = makeInt((int)misses);
+  (cells[2].c).car = makeInt(size);
+  return list;
+}
+
+
+// for the Scheme function "string-length"
+// returns the number of characters (not bytes) of a string
+Value *primitiveStringLength(Value *args){
+  if (length(args) != 1 || car(args)->type != STR_TYPE){
+    evaluationError(45);
+  }
+  return makeInt(car(args)->chars);
+}
+
+
+// for the Scheme function "string-append"
+// returns a string of the texts of its arguments one after the other,
+// in time linear in the length of the arguments after the first when the
+// first one was made by string-append (see text.h)
+Value *primitiveStringAppend(Value *args){
+  int count = length(args);
+  Value *stringsOnStack[MAX_ARGS_ON_STACK];
+  Value **strings = (count <= MAX_ARGS_ON_STACK) ? stringsOnStack : talloc(count * sizeof(Value *));
+  Value *curArg = args;
+  for (int i = 0; i < count; i++){
+    strings[i] = car(curArg);
+    if (strings[i]->type != STR_TYPE){
+      evaluationError(46);
+    }
+    curArg = cdr(curArg);
+  }
+  Value *result = stringAppend(strings, count);
+  if (count > MAX_ARGS_ON_STACK){
+    trelease(strings, count * sizeof(Value *));
+  }
+  if (result == NULL){
+    evaluationError(46);
+  }
+  return result;
+}
+
+
+// for the Scheme function "substring"
+// (substring s start end) returns the characters of s from index start
+// up to index end (or up to the end of s, if end is left out), sharing
+// the text of s instead of copying it
+Value *primitiveSubstring(Value *args){
+  int count = length(args);
+  if (count < 2 || count > 3 || car(args)->type != STR_TYPE ||
+      car(cdr(args))->type != INT_TYPE){
+    evaluationError(47);
+  }
+  Value *string = car(args);
+  int end = string->chars;
+  if (count == 3){
+    if (car(cdr(cdr(args)))->type != INT_TYPE){
+      evaluationError(47);
+    }
+    end = car(cdr(cdr(args)))->i;
+  }
+  Value *result = substring(string, car(cdr(args))->i, end);
+  if (result == NULL){
+    evaluationError(47);
+  }
+  return result;
+}
+
+
+// for the Scheme function "string=?"
+// returns #t if all its arguments are strings with the same text
+Value *primitiveStringEqual(Value *args){
+  if (args->type == NULL_TYPE){
+    evaluationError(48);
+  }
+  // (every argument is checked, even after a difference)
+  int equal = 1;
+  for (Value *curArg = args; curArg->type != NULL_TYPE; curArg = cdr(curArg)){
+    if (car(curArg)->type != STR_TYPE){
+      evaluationError(48);
+    }
+    equal = equal && stringsEqual(car(args), car(curArg));
+  }
+  return makeBool(equal);
+}
+
+
+// for the Scheme function "string->symbol"
+// returns the symbol whose name is the text of a string, taken from
+// the literal pool like the symbols of the program
+Value *primitiveStringToSymbol(Value *args){
+  if (length(args) != 1 || car(args)->type != STR_TYPE){
+    evaluationError(49);
+  }
+  Value name;
+  name.type = SYMBOL_TYPE;
+  name.s = stringToCString(car(args));
+  Value *symbol = internAtom(&name);
+  // (the pool keeps a copy of the name)
+  trelease(name.s, car(args)->length + 1);
+  return symbol;
+}
+
+
+// for the Scheme function "number->string"
+// returns the text that display shows for a number
+Value *primitiveNumberToString(Value *args){
+  if (length(args) != 1 || (car(args)->type != INT_TYPE && car(args)->type != DOUBLE_TYPE)){
+    evaluationError(50);
+  }
+  char text[512];
+  int textLength;
+  if (car(args)->type == INT_TYPE){
+    textLength = snprintf(text, sizeof(text), "%i", car(args)->i);
+  }
+  else{
+    textLength = snprintf(text, sizeof(text), "%f", car(args)->d);
+  }
+  if (textLength >= (int)sizeof(text)){
+    textLength = sizeof(text) - 1;
+  }
+  return makeString(text, textLength);
+}
+
+
+// Adds a binding between the given name (a string)
+// and the pointer to the input function. Used to add
+// bindings for primitive funtions to the top-level
+// bindings list. Each binding is a two-item list.
+void bindPrimitive(const char *name, Value *(*function)(struct Value *), Frame *frame) {
+  Value *nameVal = talloc(sizeof(Value));
+  nameVal->type = SYMBOL_TYPE;
+  nameVal->s = (char *)name;
+  Value *functionVal = talloc(sizeof(Value));
+  functionVal->type = PRIMITIVE_TYPE;
+  functionVal->primFn = function;
+  // create new binding and add to frame
+  Value *newBinding = cons(nameVal, cons(functionVal, makeNull()));
+  frame->bindings = cons(newBinding, frame->bindings);
+}
+
+
+// Returns a new frame whose parent is parent, without bindings yet
+// (counted, see counters.h).
+Frame *newFrame(Frame *parent){
+  Frame *frame = talloc(sizeof(Frame));
+  frame->bindings = makeNull();
+  frame->parent = parent;
+  if (countingOn){
+    countEvents(COUNT_FRAMES, 1);
+  }
+  return frame;
+}
+
+
+// initialize the top-level Frame, where there are no
+// bindings (bindings is an empty list) and the parent is NULL;
+Frame *initTopFrame(){
+  return newFrame(NULL);
+}
+
+
+// Parallel mode (see parallel.h). Only pure expressions are evaluated in
+// parallel: expressions that cannot define or set! anything, so the order
+// in which they run can't change the result. The analysis is syntactic
+// and conservative: special forms are checked part by part, primitives are
+// pure, and a call to a closure is pure if its body is. A call through a
+// name bound by an enclosing lambda or let is treated as impure, since
+// which function it calls is only known at run time.
+
+// incremented whenever a binding is added or changed, which may change
+// what a name in a closure body refers to; closures cache their purity
+// for one value of the epoch
+int purityEpoch = 0;
+
+
+// returns non-zero if symbol is one of the local names; locals is a list
+// of parameter lists and let bindings lists
+int isLocalName(Value *symbol, Value *locals){
+  Value *curList = locals;
+  while (curList->type == CONS_TYPE){
+    Value *curName = car(curList);
+    while (curName->type == CONS_TYPE){
+      Value *name = car(curName);
+      // bindings lists hold (name expr) pairs
+      if (name->type == CONS_TYPE){
+        name = car(name);
+      }
+      if (name->type == SYMBOL_TYPE && strcmp(name->s, symbol->s)==0){
+        return 1;
+      }
+      curName = cdr(curName);
+    }
+    curList = cdr(curList);
+  }
+  return 0;
+}
+
+
+// returns the value of symbol in frame, or NULL if it is unbound
+Value *findSymbol(Value *symbol, Frame *frame){
+  while (frame != NULL){
+    Value *curBinding = frame->bindings;
+    while (curBinding->type != NULL_TYPE){
+      if (strcmp(symbol->s, car(car(curBinding))->s)==0){
+        return car(cdr(car(curBinding)));
+      }
+      curBinding = cdr(curBinding);
+    }
+    frame = frame->parent;
+  }
+  return NULL;
+}
+
+
+int isPure(Value *expr, Frame *frame, Value *locals, Value **visited);
+
+
+// returns non-zero if every expression of the list exprs is pure
+int isPureList(Value *exprs, Frame *frame, Value *locals, Value **visited){
+  while (exprs->type == CONS_TYPE){
+    if (!isPure(car(exprs), frame, locals, visited)){
+      return 0;
+    }
+    exprs = cdr(exprs);
+  }
+  return 1;
+}
+
+
+// returns non-zero if calling the closure fn is pure. Closures being
+// checked further up (in visited) are assumed to be pure, so recursion
+// terminates; an impure result never depends on that assumption and is
+// cached right away. A memoized closure is impure, since its calls count
+// hits and misses in its memo, which memoize-stats reports.
+int isPureClosure(Value *fn, Value **visited){
+  Closure *closure = fn->closure;
+  if (closure->memoCapacity != 0){
+    return 0;
+  }
+  int epoch = __atomic_load_n(&purityEpoch, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&closure->pureEpoch, __ATOMIC_RELAXED) == epoch){
+    return 1;
+  }
+  if (__atomic_load_n(&closure->impureEpoch, __ATOMIC_RELAXED) == epoch){
+    return 0;
+  }
+  Value *curVisited = *visited;
+  while (curVisited->type != NULL_TYPE){
+    if (car(curVisited) == fn){
+      return 1;
+    }
+    curVisited = cdr(curVisited);
+  }
+  *visited = cons(fn, *visited);
+  Value *locals = cons(closure->paramNames, makeNull());
+  if (!isPureList(closure->fnBody, closure->frame, locals, visited)){
+    __atomic_store_n(&closure->impureEpoch, epoch, __ATOMIC_RELAXED);
+    return 0;
+  }
+  return 1;
+}
+
+
+// returns the purity of the primitive function
+Purity primitivePurity(Value *(*function)(Value *)){
+  for (int i = 0; i < numPrimitives; i++){
+    if (primitives[i].function == function){
+      return primitives[i].purity;
+    }
+  }
+  return IMPURE;
+}
+
+
+// returns non-zero if expr, a pure expression, evaluates to a procedure
+// that is pure to call: a lambda expression (whose body isPure() has
+// checked), or a name bound to a pure primitive or closure
+int isPureProcedure(Value *expr, Frame *frame, Value *locals, Value **visited){
+  if (expr->type == CONS_TYPE){
+    return car(expr)->type == SYMBOL_TYPE && !strcmp(car(expr)->s,"lambda");
+  }
+  if (expr->type != SYMBOL_TYPE || isLocalName(expr, locals)){
+    return 0;
+  }
+  Value *function = findSymbol(expr, frame);
+  if (function == NULL){
+    return 0;
+  }
+  if (function->type == PRIMITIVE_TYPE){
+    return primitivePurity(function->primFn) == PURE;
+  }
+  if (function->type == CLOSURE_TYPE){
+    return isPureClosure(function, visited);
+  }
+  return 0;
+}
+
+
+// returns non-zero if evaluating expr in frame is pure; names in locals
+// are bound by enclosing lambdas or lets of expr, and visited holds the
+// closures being checked
+int isPure(Value *expr, Frame *frame, Value *locals, Value **visited){
+  if (expr->type != CONS_TYPE){
+    // constants, and symbols (reading a binding is pure)
+    return 1;
+  }
+  Value *first = car(expr);
+  Value *args = cdr(expr);
+  if (first->type == SYMBOL_TYPE){
+    if (!strcmp(first->s,"quote")){
+      return 1;
+    }
+    if (!strcmp(first->s,"define") || !strcmp(first->s,"define-memoized") ||
+        !strcmp(first->s,"set!") || !strcmp(first->s,"load") || !strcmp(first->s,"with-exception-handler")){
+      // (the handler and thunk of with-exception-handler
+      // could be any procedures)
+      return 0;
+    }
+    if (!strcmp(first->s,"guard")){
+      if (args->type != CONS_TYPE || car(args)->type != CONS_TYPE){
+        return 0;
+      }
+      Value *guardLocals = cons(car(args), locals);
+      Value *curClause = cdr(car(args));
+      while (curClause->type == CONS_TYPE){
+        if (!isPureList(car(curClause), frame, guardLocals, visited)){
+          return 0;
+        }
+        curClause = cdr(curClause);
+      }
+      return isPureList(cdr(args), frame, locals, visited);
+    }
+    if (!strcmp(first->s,"lambda")){
+      return args->type == CONS_TYPE &&
+        isPureList(cdr(args), frame, cons(car(args), locals), visited);
+    }
+    if (!strcmp(first->s,"let") || !strcmp(first->s,"let*") || !strcmp(first->s,"letrec")){
+      if (args->type != CONS_TYPE || car(args)->type != CONS_TYPE){
+        return 0;
+      }
+      Value *letLocals = cons(car(args), locals);
+      Value *curBinding = car(args);
+      while (curBinding->type == CONS_TYPE){
+        Value *binding = car(curBinding);
+        if (binding->type == CONS_TYPE && cdr(binding)->type == CONS_TYPE &&
+            !isPure(car(cdr(binding)), frame, letLocals, visited)){
+          return 0;
+        }
+        curBinding = cdr(curBinding);
+      }
+      return isPureList(cdr(args), frame, letLocals, visited);
+    }
+    if (!strcmp(first->s,"if") || !strcmp(first->s,"begin") || !strcmp(first->s,"and") ||
+        !strcmp(first->s,"or") || !strcmp(first->s,"pcall") || !strcmp(first->s,"future")){
+      return isPureList(args, frame, locals, visited);
+    }
+  }
+
+  // a combination: the arguments must be pure, and so must the function
+  if (!isPureList(args, frame, locals, visited)){
+    return 0;
+  }
+  if (first->type == CONS_TYPE){
+    // only a lambda expression is known to produce a pure function
+    return car(first)->type == SYMBOL_TYPE && !strcmp(car(first)->s,"lambda") &&
+      isPure(first, frame, locals, visited);
+  }
+  if (first->type != SYMBOL_TYPE || isLocalName(first, locals)){
+    return 0;
+  }
+  Value *function = findSymbol(first, frame);
+  if (function == NULL){
+    return 0;
+  }
+  if (function->type == PRIMITIVE_TYPE){
+    Purity purity = primitivePurity(function->primFn);
+    if (purity == PURE_IF_PROCEDURE_PURE){
+      return args->type == CONS_TYPE && isPureProcedure(car(args), frame, locals, visited);
+    }
+    return purity == PURE;
+  }
+  if (function->type == CLOSURE_TYPE){
+    return isPureClosure(function, visited);
+  }
+  return 0;
+}
+
+
+// returns non-zero if evaluating expr in frame is pure
+int isPureExpr(Value *expr, Frame *frame){
+  Value *visited = makeNull();
+  if (!isPure(expr, frame, makeNull(), &visited)){
+    return 0;
+  }
+  // the assumptions made about the visited closures held
+  int epoch = __atomic_load_n(&purityEpoch, __ATOMIC_RELAXED);
+  while (visited->type != NULL_TYPE){
+    __atomic_store_n(&car(visited)->closure->pureEpoch, epoch, __ATOMIC_RELAXED);
+    visited = cdr(visited);
+  }
+  return 1;
+}
+
+
+// notes that a binding was added or changed
+void bindingsChanged(){
+  __atomic_fetch_add(&purityEpoch, 1, __ATOMIC_RELAXED);
+}
+
+
+// returns non-zero if the count expressions of exprs are worth evaluating
+// in parallel: at least two of them are combinations (anything else takes
+// no time to evaluate) and all of them are pure
+int worthParallel(Value **exprs, int count, Frame *frame){
+  if (!parallelEnabled()){
+    return 0;
+  }
+  int combinations = 0;
+  for (int i = 0; i < count; i++){
+    if (exprs[i]->type == CONS_TYPE){
+      combinations++;
+    }
+  }
+  if (combinations < 2){
+    return 0;
+  }
+  for (int i = 0; i < count; i++){
+    if (!isPureExpr(exprs[i], frame)){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+// A task evaluating one expression. If the evaluation raises an error,
+// failed is set and error and raised hold the error (see raiseError()).
+struct EvalTask {
+  Task task;
+  Value *expr;
+  Frame *frame;
+  // the heap of the interpreter that created the task
+  Heap *heap;
+  // the call depth of the thread that created the task
+  int depth;
+  Value *result;
+  int failed;
+  int error;
+  Value *raised;
+  // the future started before it on the same thread (see pendingFutures)
+  struct EvalTask *nextFuture;
+};
+
+typedef struct EvalTask EvalTask;
+
+
+// The futures started by the evaluation running on this thread (the
+// program's, or a task's) that may not be done yet, the latest first. A
+// future's task reads the bindings of its frames while the evaluation that
+// started it goes on, so before it changes a binding, the evaluation waits
+// for them (see settleFutures()): a future then never sees a change made
+// after it in program order, just as when it is evaluated right away.
+static _Thread_local EvalTask *pendingFutures = NULL;
+
+
+// the run function of an EvalTask
+void runEvalTask(Task *task){
+  EvalTask *evalTask = (EvalTask *)task;
+  jmp_buf trap;
+  jmp_buf *outerTrap = errorTrap;
+  Heap *outerHeap = activeHeap();
+  int outerDepth = callDepth;
+  stackInitThread();
+  errorTrap = &trap;
+  setActiveHeap(evalTask->heap);
+  // the task counts its calls from the depth of the one that spawned it,
+  // whichever thread runs it
+  callDepth = evalTask->depth;
+  // the task only waits for the futures it starts itself
+  EvalTask *outerFutures = pendingFutures;
+  pendingFutures = NULL;
+  if (setjmp(trap) == 0){
+    Value *result = eval(evalTask->expr, evalTask->frame);
+    gcWriteBarrier(result);
+    evalTask->result = result;
+  }
+  else{
+    evalTask->failed = 1;
+    evalTask->error = raisedType;
+    evalTask->raised = raisedObject;
+  }
+  pendingFutures = outerFutures;
+  callDepth = outerDepth;
+  setActiveHeap(outerHeap);
+  errorTrap = outerTrap;
 }
 
 
-// for the Scheme primitive function ">" 
-// takes in a list of reals (double/integer)
-// and return true if its arguments are monotonically
-// decreasing, i.e., each argument is greater than the preceding ones
-Value *primitiveGreaterThan(Value *args) {
-  // args should be a proper list
-  assert((args->type == CONS_TYPE || args->type == NULL_TYPE) && "Error (primitiveGreaterThan): args is not a list");
-  // if args is empty, return true
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = BOOL_TYPE;
-  if (args->type == NULL_TYPE){
-    returnVal->i = 1;
-    return returnVal;
-  }
+// sets up task to evaluate expr in frame
+void initEvalTask(EvalTask *task, Value *expr, Frame *frame){
+  task->task.run = runEvalTask;
+  task->task.data = NULL;
+  task->task.done = 0;
+  task->expr = expr;
+  task->frame = frame;
+  task->heap = activeHeap();
+  task->depth = callDepth;
+  task->result = NULL;
+  task->failed = 0;
+  task->error = 0;
+  task->raised = NULL;
+  task->nextFuture = NULL;
+}
 
-  Value *firstNum = car(args);
-  double firstNumVal;
-  // check the first number's type is correct
-  if ((firstNum->type != DOUBLE_TYPE) && (firstNum->type != INT_TYPE)){
-    evaluationError(8);
+
+// Evaluates the count expressions of exprs in frame in parallel, the first
+// one on the calling thread, and returns the tasks once all of them are
+// done. Errors are not raised here: taskResult() raises them, so the caller
+// can report the first one in program order.
+EvalTask *evalInParallel(Value **exprs, int count, Frame *frame){
+  EvalTask *tasks = talloc(count * sizeof(EvalTask));
+  for (int i = 0; i < count; i++){
+    initEvalTask(&tasks[i], exprs[i], frame);
   }
-  // if there is only one number, return true
-  if (length(args) < 2){
-    returnVal->i = 1;
-    return returnVal;
+  for (int i = 1; i < count; i++){
+    spawnTask(&tasks[i].task);
   }
-  // get the first number's value for comparison
-  if (firstNum->type == DOUBLE_TYPE){
-    firstNumVal = firstNum->d;
+  runEvalTask(&tasks[0].task);
+  for (int i = 1; i < count; i++){
+    waitForTask(&tasks[i].task);
+  }
+  return tasks;
+}
+
+
+// returns the value computed by a finished task, raising
+// the error it failed with instead, if any
+Value *taskResult(EvalTask *task){
+  if (task->failed){
+    raiseError(task->error, task->raised);
+  }
+  return task->result;
+}
+
+
+// Evaluates (future expr), returning a future whose value touch returns.
+// A pure expr becomes a task (run in parallel in the parallel mode, and
+// right away otherwise), and an error it raises is only reported when the
+// future is touched. Anything else is evaluated right away, so that its
+// side effects happen in program order.
+Value *evalFuture(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE || length(args) != 1){
+    evaluationError(23);
+  }
+  Value *expr = car(args);
+  EvalTask *task = talloc(sizeof(EvalTask));
+  initEvalTask(task, expr, frame);
+  Value *future = talloc(sizeof(Value));
+  future->type = FUTURE_TYPE;
+  future->future = task;
+  if (!isPureExpr(expr, frame)){
+    Value *result = eval(expr, frame);
+    gcWriteBarrier(result);
+    task->result = result;
+    task->task.done = 1;
+  }
+  else if (parallelEnabled()){
+    task->nextFuture = pendingFutures;
+    pendingFutures = task;
+    spawnTask(&task->task);
   }
   else{
-    firstNumVal = (firstNum->i)*1.0; // cast integer to double
+    runEvalTask(&task->task);
+    task->task.done = 1;
   }
-  // check if each argument is less than the preceding one
-  Value *curArg = cdr(args);
-  double prevNumVal = firstNumVal;
-  while (curArg->type != NULL_TYPE){
-    Value *curNum = car(curArg);
-    double curNumVal;
-    // check the current number's type is correct
-    if (curNum->type != DOUBLE_TYPE && curNum->type != INT_TYPE){
-      evaluationError(8);
-    }
-    // get the current number's value
-    if (curNum->type == DOUBLE_TYPE){
-      curNumVal = curNum->d;
-    }
-    else{
-      curNumVal = (curNum->i)*1.0;
-    }
-    // if current number is not smaller than the previous number, return false
-    if (!(curNumVal < prevNumVal)){
-      returnVal->i = 0;
-      return returnVal;
-    }
-    prevNumVal = curNumVal;
-    curArg = cdr(curArg);
+  return future;
+}
+
+
+// Waits for the futures this thread's evaluation has started, before it
+// changes a binding that they could read.
+void settleFutures(){
+  while (pendingFutures != NULL){
+    waitForTask(&pendingFutures->task);
+    pendingFutures = pendingFutures->nextFuture;
   }
-  returnVal->i = 1;
-  return returnVal;
 }
 
 
-// Adds a binding between the given name (a string)
-// and the pointer to the input function. Used to add
-// bindings for primitive funtions to the top-level
-// bindings list. Each binding is a two-item list.
-void bind(char *name, Value *(*function)(struct Value *), Frame *frame) {
-  Value *nameVal = talloc(sizeof(Value));
-  nameVal->type = SYMBOL_TYPE;
-  nameVal->s = name;
-  Value *functionVal = talloc(sizeof(Value));
-  functionVal->type = PRIMITIVE_TYPE;
-  functionVal->primFn = function;
-  // create new binding and add to frame
-  Value *newBinding = cons(nameVal, cons(functionVal, makeNull()));
-  frame->bindings = cons(newBinding, frame->bindings);
+// (touch f) waits for the future f and returns its value, or raises the
+// error its expression raised; any other value is returned as it is
+Value *primitiveTouch(Value *args){
+  if (length(args) != 1){
+    evaluationError(23);
+  }
+  Value *arg = car(args);
+  if (arg->type != FUTURE_TYPE){
+    return arg;
+  }
+  waitForTask(&arg->future->task);
+  return taskResult(arg->future);
 }
 
 
-// initialize the top-level Frame, where there are no
-// bindings (bindings is an empty list) and the parent is NULL;
-Frame *initTopFrame(){
-  Frame *topFrame = talloc(sizeof(Frame));
-  topFrame->bindings = makeNull();
-  topFrame->parent = NULL;
+// returns an array of the items of list, which has count items
+Value **listToArray(Value *list, int count){
+  Value **items = talloc(count * sizeof(Value *));
+  for (int i = 0; i < count; i++){
+    items[i] = car(list);
+    list = cdr(list);
+  }
+  return items;
+}
+
+
+// The primitive functions and their Scheme names, the most used first
+// (see makeTopFrame())
+const Primitive primitives[] = {
+  {"+", primitiveAdd, PURE},
+  {"null?", primitiveCheckNull, PURE},
+  {"car", primitiveCar, PURE},
+  {"cdr", primitiveCdr, PURE},
+  {"cons", primitiveCons, PURE},
+  {"=", primitiveEqual, PURE},
+  {"-", primitiveMinus, PURE},
+  {"<", primitiveLessThan, PURE},
+  {">", primitiveGreaterThan, PURE},
+  {"touch", primitiveTouch, PURE},
+  {"raise", primitiveRaise, PURE},
+  {"display", primitiveDisplay, IMPURE},
+  {"newline", primitiveNewline, IMPURE},
+  {"list", primitiveList, PURE},
+  {"append", primitiveAppend, PURE},
+  {"length", primitiveLength, PURE},
+  {"reverse", primitiveReverse, PURE},
+  {"list-tail", primitiveListTail, PURE},
+  {"map", primitiveMap, PURE_IF_PROCEDURE_PURE},
+  {"for-each", primitiveForEach, PURE_IF_PROCEDURE_PURE},
+  {"filter", primitiveFilter, PURE_IF_PROCEDURE_PURE},
+  {"fold-left", primitiveFoldLeft, PURE_IF_PROCEDURE_PURE},
+  {"eq?", primitiveEq, PURE},
+  {"eqv?", primitiveEqv, PURE},
+  {"equal?", primitiveEqualP, PURE},
+  {"equal-hash", primitiveEqualHash, PURE},
+  {"member", primitiveMember, PURE},
+  {"assoc", primitiveAssoc, PURE},
+  {"memoize", primitiveMemoize, IMPURE},
+  {"memoize-stats", primitiveMemoizeStats, IMPURE},
+  {"string-length", primitiveStringLength, PURE},
+  {"string-append", primitiveStringAppend, PURE},
+  {"substring", primitiveSubstring, PURE},
+  {"string=?", primitiveStringEqual, PURE},
+  {"string->symbol", primitiveStringToSymbol, PURE},
+  {"number->string", primitiveNumberToString, PURE},
+};
+
+const int numPrimitives = sizeof(primitives) / sizeof(Primitive);
+
+
+// Returns a new top-level frame, with the primitive functions bound
+Frame *makeTopFrame(){
+  Frame *topFrame = initTopFrame();
+  // each binding goes in front of the others, so binding the table from
+  // the end leaves the bindings in its order, and lookups find the
+  // primitives near the start of the table (the arithmetic) first
+  for (int i = numPrimitives - 1; i >= 0; i--){
+    bindPrimitive(primitives[i].name, primitives[i].function, topFrame);
+  }
   return topFrame;
 }
 
 
+// when set, an error raised by a top-level form is printed and
+// interpretIn() moves on to the next form, instead of exiting
+int continueAfterErrors = 0;
+
+
+// Makes interpretIn() continue after errors (if on is non-zero).
+void setContinueAfterErrors(int on){
+  continueAfterErrors = on;
+}
+
+
+// Limits the depth of closure calls (0 for no limit but the stack).
+void setMaxCallDepth(int depth){
+  maxCallDepth = depth;
+}
+
+
+// evaluates a top-level form and prints its value
+// (or the error it raised, when continuing after errors)
+void interpretForm(Value *expr, Frame *topFrame){
+  Value *result;
+  if (!continueAfterErrors){
+    result = eval(expr, topFrame);
+  }
+  else{
+    jmp_buf trap;
+    jmp_buf *outerTrap = errorTrap;
+    int outerDepth = callDepth;
+    errorTrap = &trap;
+    if (setjmp(trap) != 0){
+      errorTrap = outerTrap;
+      callDepth = outerDepth;
+      printError(raisedType, raisedObject);
+      return;
+    }
+    result = eval(expr, topFrame);
+    errorTrap = outerTrap;
+  }
+  // using the printTree() function in the parser
+  printTree(result);
+  outputChar('\n');
+  outputFlush();
+}
+
+
 //Interprets each top level S-expression in the tree
 //and prints out the results.
 void interpret(Value *tree){
+  interpretIn(tree, makeTopFrame());
+}
+
+
+// Interprets each top level S-expression in the tree in topFrame, which
+// keeps the definitions for the next call
+void interpretIn(Value *tree, Frame *topFrame){
   Value *curExpr = tree;
-  Value* result;
-  Frame *topFrame = initTopFrame();
-  // binding primitive functions to their Scheme names
-  bind("+", primitiveAdd, topFrame);
-  bind("null?", primitiveCheckNull, topFrame);
-  bind("car", primitiveCar, topFrame);
-  bind("cdr", primitiveCdr, topFrame);
-  bind("cons", primitiveCons, topFrame);
-  bind("=", primitiveEqual, topFrame);
-  bind("-", primitiveMinus, topFrame);
-  bind("<", primitiveLessThan, topFrame);
-  bind(">", primitiveGreaterThan, topFrame);
+  pthread_once(&smallIntsOnce, initSmallInts);
+  stackInitThread();
+  // (an error that ended an earlier program of the thread, see interp.h,
+  // may have left the depth higher)
+  callDepth = 0;
   // the tree should be either NULL_TYPE or CONS_TYPE
   // as created by the parser
   while (curExpr->type != NULL_TYPE){
-    result = eval(car(curExpr), topFrame);
-    // using the printTree() function in the parser
-    printTree(result);
-    printf("\n");
+    // in the parallel mode, a run of pure combinations is
+    // evaluated at once, and the results printed in order
+    int count = 0;
+    Value *curRun = curExpr;
+    while (parallelEnabled() && curRun->type != NULL_TYPE &&
+           car(curRun)->type == CONS_TYPE && isPureExpr(car(curRun), topFrame)){
+      count++;
+      curRun = cdr(curRun);
+    }
+    if (count >= 2){
+      Value **exprs = listToArray(curExpr, count);
+      EvalTask *tasks = evalInParallel(exprs, count, topFrame);
+      for (int i = 0; i < count; i++){
+        if (tasks[i].failed && continueAfterErrors){
+          printError(tasks[i].error, tasks[i].raised);
+          continue;
+        }
+        printTree(taskResult(&tasks[i]));
+        outputChar('\n');
+      }
+      outputFlush();
+      trelease(exprs, count * sizeof(Value *));
+      trelease(tasks, count * sizeof(EvalTask));
+      curExpr = curRun;
+      continue;
+    }
+    interpretForm(car(curExpr), topFrame);
     curExpr = cdr(curExpr);
   }
   return;
@@ -653,20 +2240,42 @@ Value *evalLet(Value *args, Frame *frame){
 
   Value *bindingsList = car(args);
   Value *body = cdr(args);
-  Frame *localFrame = talloc(sizeof(Frame));
   Value *localBindings = makeNull();
   
   // if bindings list is empty, it should be stored
   // as just a NULL_TYPE Value in the local frame
   // or else, we need to add the bindings to the local frame
   if (!(((car(bindingsList))->type == NULL_TYPE) && ((cdr(bindingsList))->type == NULL_TYPE))){
+    // in the parallel mode, the expressions may all be
+    // evaluated at once, before the bindings are made
+    EvalTask *tasks = NULL;
+    if (parallelEnabled()){
+      int count = length(bindingsList);
+      Value **exprs = listToArray(bindingsList, count);
+      for (int i = 0; i < count; i++){
+        exprs[i] = car(cdr(exprs[i]));
+      }
+      if (worthParallel(exprs, count, frame)){
+        tasks = evalInParallel(exprs, count, frame);
+      }
+      trelease(exprs, count * sizeof(Value *));
+    }
+
     // loop through all pairs of bindings and add to 
     // localBindings (for the local frame)
     Value *curBinding = bindingsList;
+    int index = 0;
     while (curBinding->type != NULL_TYPE){
       Value *curSymbol = car(car(curBinding));
       // evaluate the binding in the passed in frame
-      Value *curSymbolValue = eval(car(cdr(car(curBinding))), frame);
+      Value *curSymbolValue;
+      if (tasks != NULL){
+        curSymbolValue = taskResult(&tasks[index]);
+      }
+      else{
+        curSymbolValue = eval(car(cdr(car(curBinding))), frame);
+      }
+      index++;
       // checking whether the symbol is already defined
       // previously in the bindings list of the let frame
       Value *curLocalBinding = localBindings;
@@ -683,11 +2292,16 @@ Value *evalLet(Value *args, Frame *frame){
 
       curBinding = cdr(curBinding);
     }
+    if (tasks != NULL){
+      trelease(tasks, index * sizeof(EvalTask));
+    }
   }
 
   // evaluate the bodies in the local frame
+  // (created only now, so it is never seen half-initialized by the
+  // collector while the bindings are evaluated)
+  Frame *localFrame = newFrame(frame);
   localFrame->bindings = localBindings;
-  localFrame->parent = frame;
   Value *curBody = body;
   Value *result;
   while (curBody->type != NULL_TYPE){
@@ -710,10 +2324,8 @@ Value *evalLetStar(Value *args, Frame *frame){
 
   Value *bindingsList = car(args);
   Value *body = cdr(args);
-  Frame *localFrame = talloc(sizeof(Frame));
+  Frame *localFrame = newFrame(frame);
   Value *localBindings = makeNull();
-  localFrame->bindings = localBindings;
-  localFrame->parent = frame;
 
   // if bindings list is empty, it should be stored
   // as just a NULL_TYPE Value in the local frame
@@ -740,7 +2352,10 @@ Value *evalLetStar(Value *args, Frame *frame){
       Value *newBinding = cons(curSymbol, cons(curSymbolValue, makeNull()));
       localBindings = cons(newBinding, localBindings);
       // update the bindings list in the frame
+      settleFutures();
+      gcWriteBarrier(localBindings);
       localFrame->bindings = localBindings;
+      bindingsChanged();
 
       curBinding = cdr(curBinding);
     }
@@ -768,10 +2383,8 @@ Value *evalLetrec(Value *args, Frame *frame){
 
   Value *bindingsList = car(args);
   Value *body = cdr(args);
-  Frame *localFrame = talloc(sizeof(Frame));
+  Frame *localFrame = newFrame(frame);
   Value *localBindings = makeNull();
-  localFrame->bindings = localBindings;
-  localFrame->parent = frame;
   
   // if bindings list is empty, it should be stored
   // as just a NULL_TYPE Value in the local frame
@@ -803,7 +2416,10 @@ Value *evalLetrec(Value *args, Frame *frame){
   }
 
   // evaluate the bodies in the local frame
+  settleFutures();
+  gcWriteBarrier(localBindings);
   localFrame->bindings = localBindings;
+  bindingsChanged();
   Value *curBody = body;
   Value *result;
   while (curBody->type != NULL_TYPE){
@@ -816,17 +2432,33 @@ Value *evalLetrec(Value *args, Frame *frame){
 }
 
 
+// counts a frame lookUpSymbol() looked in, where it compared the names
+// of compared bindings
+static void countLookUp(long compared){
+  countEvents(COUNT_LOOKUP_FRAMES, 1);
+  countEvents(COUNT_LOOKUP_BINDINGS, compared);
+}
+
+
 // returns the value of expr in the environment
 // expr passed in must be SYMBOL_TYPE
 Value *lookUpSymbol(Value *expr, Frame *frame){
   Value *curBinding = frame->bindings;
+  long compared = 0;
   // look up in the curParament frame
   while (curBinding->type != NULL_TYPE){
+    compared++;
     if (strcmp(expr->s, car(car(curBinding))->s)==0){
+      if (countingOn){
+        countLookUp(compared);
+      }
       return car(cdr(car(curBinding)));
     }
     curBinding = cdr(curBinding);
   }
+  if (countingOn){
+    countLookUp(compared);
+  }
   // look up in the parent frame
   if (frame->parent != NULL){
     return lookUpSymbol(expr, frame->parent);
@@ -839,6 +2471,20 @@ Value *lookUpSymbol(Value *expr, Frame *frame){
 }
 
 
+// a frame whose bindings set! must not change on this thread
+// (see setSealedFrame())
+_Thread_local Frame *sealedFrame = NULL;
+
+
+// Makes set! of a binding in frame raise an error on the calling thread
+// (NULL seals nothing), and returns the frame sealed before.
+Frame *setSealedFrame(Frame *frame){
+  Frame *oldFrame = sealedFrame;
+  sealedFrame = frame;
+  return oldFrame;
+}
+
+
 // returns the Value whose car is the value of expr
 // in the environment
 Value *getSymbolBinding(Value *expr, Frame *frame){
@@ -846,13 +2492,16 @@ Value *getSymbolBinding(Value *expr, Frame *frame){
   // look up in the curParament frame
   while (curBinding->type != NULL_TYPE){
     if (strcmp(expr->s, car(car(curBinding))->s)==0){
+      if (frame == sealedFrame){
+        evaluationError(28);
+      }
       return cdr(car(curBinding));
     }
     curBinding = cdr(curBinding);
   }
   // look up in the parent frame
   if (frame->parent != NULL){
-    return lookUpSymbol(expr, frame->parent);
+    return getSymbolBinding(expr, frame->parent);
   } 
   else{
     // unbound variable
@@ -893,15 +2542,9 @@ void checkDefineArgs(Value *args){
 }
 
 
-// creates binding in the top-level frame
-// if frame passed in is not the top-level frame,
-// define will just create bindings in the frame passed in
-// if symbol already exists, error will be raised
-Value *evalDefine(Value *args, Frame *frame){
-  checkDefineArgs(args);
-  Value *var = car(args);
-  Value *expr = eval(car(cdr(args)), frame); //expr is evaluated
-
+// adds a binding of var to value in frame
+// if var is already bound in frame, error will be raised
+void defineInFrame(Value *var, Value *value, Frame *frame){
   // first check if the variable is already in 
   // the current frame. if so, raise error
   Value *curLocalBinding = frame->bindings;
@@ -913,12 +2556,26 @@ Value *evalDefine(Value *args, Frame *frame){
   }
 
   // add new binding to the frame
-  Value *binding = cons(var, cons(expr, makeNull()));
-  frame->bindings = cons(binding, frame->bindings);
+  settleFutures();
+  Value *binding = cons(var, cons(value, makeNull()));
+  Value *newBindings = cons(binding, frame->bindings);
+  gcWriteBarrier(newBindings);
+  frame->bindings = newBindings;
+  bindingsChanged();
+}
+
+
+// creates binding in the top-level frame
+// if frame passed in is not the top-level frame,
+// define will just create bindings in the frame passed in
+// if symbol already exists, error will be raised
+Value *evalDefine(Value *args, Frame *frame){
+  checkDefineArgs(args);
+  Value *var = car(args);
+  Value *expr = eval(car(cdr(args)), frame); //expr is evaluated
+  defineInFrame(var, expr, frame);
   // return a VOID_TYPE value to avoid printing
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = VOID_TYPE;
-  return returnVal;
+  return makeVoid();
 }
 
 
@@ -994,13 +2651,38 @@ Value *evalLambda(Value *args, Frame *frame){
   Value *body = cdr(args); // note: we can have >1 body!
   Value *fn = talloc(sizeof(Value));
   fn->type = CLOSURE_TYPE;
-  fn->closure.paramNames = paramList;
-  fn->closure.fnBody = body;
-  fn->closure.frame = frame;
+  fn->closure = talloc(sizeof(Closure));
+  fn->closure->paramNames = paramList;
+  fn->closure->fnBody = body;
+  fn->closure->frame = frame;
+  fn->closure->pureEpoch = -1;
+  fn->closure->impureEpoch = -1;
+  fn->closure->memo = NULL;
+  fn->closure->memoCapacity = 0;
   return fn; 
 }
 
 
+// (define-memoized (name param ...) body ...) defines name like
+// (define name (lambda (param ...) body ...)), but with its results
+// cached like those of (memoize name)
+Value *evalDefineMemoized(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE || car(args)->type != CONS_TYPE ||
+      car(car(args))->type != SYMBOL_TYPE){
+    evaluationError(43);
+  }
+  Value *var = car(car(args));
+  Value *params = cdr(car(args));
+  if (params->type == NULL_TYPE){
+    // (the empty parameter list, as the parser builds it for lambda)
+    params = cons(makeNull(), makeNull());
+  }
+  Value *lambda = evalLambda(cons(params, cdr(args)), frame);
+  defineInFrame(var, memoizedClosure(lambda, DEFAULT_MEMO_CAPACITY), frame);
+  return makeVoid();
+}
+
+
 // alters existing binding in the environment
 Value *evalSet(Value *args, Frame *frame){
   // same error checking as Define (same syntax)
@@ -1012,12 +2694,13 @@ Value *evalSet(Value *args, Frame *frame){
   // in the environment, if symbol does not exists, 
   // error will be raised by getSymbolBinding()
   Value *oldVal = getSymbolBinding(var, frame);
+  settleFutures();
+  gcWriteBarrier(expr);
   (oldVal->c).car = expr;
+  bindingsChanged();
 
   // return a VOID_TYPE value to avoid printing
-  Value *returnVal = talloc(sizeof(Value));
-  returnVal->type = VOID_TYPE;
-  return returnVal;
+  return makeVoid();
 }
 
 
@@ -1027,9 +2710,7 @@ Value *evalSet(Value *args, Frame *frame){
 Value *evalBegin(Value *args, Frame *frame){
   // if there is no argument to evaluate, return VOID_TYPE
   if (length(args) == 0){
-    Value *returnVal = talloc(sizeof(Value));
-    returnVal->type = VOID_TYPE;
-    return returnVal;
+    return makeVoid();
   }
   Value *curExpr = args;
   Value *result;
@@ -1043,6 +2724,53 @@ Value *evalBegin(Value *args, Frame *frame){
 }
 
 
+// returns the parse tree of the file at path (see parseModule() in
+// parsecache.h), or NULL if it can't be read; raises an error if it
+// has a syntax error, instead of exiting
+static Value *loadModule(const char *path){
+  // the tokenizer and parser texit() on a syntax error, which jumps back
+  // here; it prints no message, as the error raised instead may be caught
+  int outerQuiet = setQuietSyntaxErrors(1);
+  jmp_buf *outerTrap = exitTrap;
+  jmp_buf trap;
+  exitTrap = &trap;
+  Value *tree = NULL;
+  int failed = setjmp(trap);
+  if (!failed){
+    tree = parseModule(path);
+  }
+  exitTrap = outerTrap;
+  setQuietSyntaxErrors(outerQuiet);
+  if (failed){
+    evaluationError(52);
+  }
+  return tree;
+}
+
+
+// (load filename) evaluates the top-level forms of the file in frame,
+// without printing their values. The file is parsed only the first time
+// it is loaded (see parseModule() in parsecache.h).
+Value *evalLoad(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE || length(args) != 1){
+    evaluationError(29);
+  }
+  Value *filename = eval(car(args), frame);
+  if (filename->type != STR_TYPE){
+    evaluationError(29);
+  }
+  Value *tree = loadModule(stringToCString(filename));
+  if (tree == NULL){
+    evaluationError(29);
+  }
+  while (tree->type != NULL_TYPE){
+    eval(car(tree), frame);
+    tree = cdr(tree);
+  }
+  return makeVoid();
+}
+
+
 // evaluates all expressions in order until one is #f
 // and returns #f in that case. Return the last expression
 // if no expressions evaluate to #f
@@ -1050,10 +2778,7 @@ Value *evalBegin(Value *args, Frame *frame){
 Value *evalAnd(Value *args, Frame *frame){
   // if there are no arguments, return true
   if (length(args) == 0){
-    Value *returnVal = talloc(sizeof(Value));
-    returnVal->type = BOOL_TYPE;
-    returnVal->i = 1;
-    return returnVal;  
+    return makeBool(1);
   }
   // evaluate the expressions in order
   Value *curExpr = args;
@@ -1079,10 +2804,7 @@ Value *evalAnd(Value *args, Frame *frame){
 Value *evalOr(Value *args, Frame *frame){
   // if there are no arguments, return false
   if (length(args) == 0){
-    Value *returnVal = talloc(sizeof(Value));
-    returnVal->type = BOOL_TYPE;
-    returnVal->i = 0;
-    return returnVal;  
+    return makeBool(0);
   }
   // evaluate the expressions in order
   Value *curExpr = args;
@@ -1102,21 +2824,65 @@ Value *evalOr(Value *args, Frame *frame){
 
 
 //returns a list with all the items in args evaluated (in order)
+//the list is built front to back, appending at lastCell,
+//so no temporary reversed list is needed
 Value *evalArgs(Value *args, Frame *frame){
   Value *evaledArgList = makeNull();
+  Value *lastCell = NULL;
   Value *curArg = args;
   while (curArg->type != NULL_TYPE) {
     Value *curArgEvaled = eval(car(curArg), frame);
-    evaledArgList = cons(curArgEvaled, evaledArgList);
+    Value *newCell = cons(curArgEvaled, makeNull());
+    if (lastCell == NULL){
+      evaledArgList = newCell;
+    }
+    else{
+      (lastCell->c).cdr = newCell;
+    }
+    lastCell = newCell;
     curArg = cdr(curArg);
   }
-  evaledArgList = reverse(evaledArgList);
   return evaledArgList;
 }
 
 
+// evaluates the body of the closure function in fnFrame, where its
+// parameters are bound, and returns the value of the last expression
+Value *evalClosureBody(Value *function, Frame *fnFrame){
+  Value *curBody = function->closure->fnBody;
+  Value *result;
+  callDepth++;
+  if (maxCallDepth != 0 && callDepth > maxCallDepth){
+    evaluationError(51);
+  }
+  // here we assumed fnBody have at least one body
+  // this should be checked while evaulating lambda
+  while (curBody->type != NULL_TYPE){
+    result = eval(car(curBody), fnFrame);
+    curBody = cdr(curBody);
+  }
+  callDepth--;
+  return result; // result of last body returned
+}
+
+
+Value *applyMemoized(Value *function, Value **args, int count);
+
+
+// counts a call of function through apply() or applyArray()
+static void countApply(Value *function){
+  countEvents(COUNT_APPLY, 1);
+  if (function->type == PRIMITIVE_TYPE){
+    countPrimitiveCall(function->primFn);
+  }
+}
+
+
 //Evaluate the function body (found in the closure) with the new frame as its environment, and return the result of the call to eval.
 Value *apply(Value *function, Value *args){
+  if (countingOn){
+    countApply(function);
+  }
   // apply primitive functions
   if (function->type == PRIMITIVE_TYPE){
     return (*(function->primFn))(args);
@@ -1125,15 +2891,31 @@ Value *apply(Value *function, Value *args){
   if (function->type != CLOSURE_TYPE){
     evaluationError(14);
   }
+  if (function->closure->memoCapacity != 0){
+    // (the results are looked up by the argument values, so
+    // the arguments are passed like those of applyArray())
+    Value *argsOnStack[MAX_ARGS_ON_STACK];
+    int count = length(args);
+    Value **argArray = (count <= MAX_ARGS_ON_STACK) ? argsOnStack : talloc(count * sizeof(Value *));
+    Value *curArg = args;
+    for (int i = 0; i < count; i++){
+      argArray[i] = car(curArg);
+      curArg = cdr(curArg);
+    }
+    Value *result = applyMemoized(function, argArray, count);
+    if (count > MAX_ARGS_ON_STACK){
+      trelease(argArray, count * sizeof(Value *));
+    }
+    return result;
+  }
   // Construct a new frame with parent being 
   // the environment of the closure
-  Frame *fnFrame = talloc(sizeof(Frame));
-  fnFrame->parent = (function->closure).frame;
+  Frame *fnFrame = newFrame(function->closure->frame);
 
   // add bindings to the new frame
   // mapping each formal param in closure
   // to the actual params in args
-  Value *curFormal = (function->closure).paramNames;
+  Value *curFormal = function->closure->paramNames;
   Value *curActual = args;
   Value *localBindings = makeNull();
 
@@ -1163,21 +2945,240 @@ Value *apply(Value *function, Value *args){
   }
 
   fnFrame->bindings = localBindings;
-  Value *curBody = (function->closure).fnBody;
+  return evalClosureBody(function, fnFrame);
+}
+
+
+// calls the closure function with the count values in args,
+// binding its parameters straight from args
+Value *applyClosure(Value *function, Value **args, int count){
+  Frame *fnFrame = newFrame(function->closure->frame);
+  Value *localBindings = makeNull();
+  // (a closure without parameters has the empty list as paramNames)
+  Value *curFormal = function->closure->paramNames;
+  int i = 0;
+  while (isItemCell(curFormal)){
+    if (i == count){
+      evaluationError(15);
+    }
+    Value *oneBinding = cons(car(curFormal), cons(args[i], makeNull()));
+    localBindings = cons(oneBinding, localBindings);
+    curFormal = cdr(curFormal);
+    i++;
+  }
+  if (i != count){
+    evaluationError(15);
+  }
+  fnFrame->bindings = localBindings;
+  return evalClosureBody(function, fnFrame);
+}
+
+
+// calls the memoized closure function with the count values in args,
+// returning the result of an earlier call with equal arguments if its
+// memo still holds one
+Value *applyMemoized(Value *function, Value **args, int count){
+  Closure *closure = function->closure;
+  if (closure->memo == NULL && sealedFrame == NULL){
+    // a closure loaded from an image (see image.c) gets
+    // a new memo from the first interpreter calling it
+    Memo *memo = memoCreate(closure->memoCapacity);
+    Memo *expected = NULL;
+    gcWriteBarrier(memo);
+    __atomic_compare_exchange_n(&closure->memo, &expected, memo, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  }
+  Memo *memo = closure->memo;
+  uint64_t hash;
   Value *result;
-  // here we assumed fnBody have at least one body
-  // this should be checked while evaulating lambda
-  while (curBody->type != NULL_TYPE){
-    result = eval(car(curBody), fnFrame);
-    curBody = cdr(curBody);
+  if (memo == NULL || !memoLookup(memo, args, count, &hash, &result)){
+    result = applyClosure(function, args, count);
+    if (memo != NULL){
+      memoStore(memo, args, count, hash, result);
+    }
   }
-  return result; // result of last body returned
+  return result;
+}
+
+
+// Calls function with the count values in args, like apply() but without
+// an argument list to build and release: a primitive gets a list built on
+// the stack, and a closure's parameters are bound straight from args.
+Value *applyArray(Value *function, Value **args, int count){
+  if (countingOn){
+    countApply(function);
+  }
+  if (function->type == PRIMITIVE_TYPE){
+    // (primitives never keep the cells of the list they are given)
+    Value cellsOnStack[MAX_ARGS_ON_STACK];
+    Value *cells = (count <= MAX_ARGS_ON_STACK) ? cellsOnStack : talloc(count * sizeof(Value));
+    for (int i = 0; i < count; i++){
+      cells[i].type = CONS_TYPE;
+      cells[i].c.car = args[i];
+      cells[i].c.cdr = (i + 1 < count) ? &cells[i + 1] : makeNull();
+    }
+    Value *result = (*(function->primFn))((count == 0) ? makeNull() : cells);
+    if (count > MAX_ARGS_ON_STACK){
+      trelease(cells, count * sizeof(Value));
+    }
+    return result;
+  }
+  if (function->type != CLOSURE_TYPE){
+    evaluationError(14);
+  }
+  if (function->closure->memoCapacity != 0){
+    return applyMemoized(function, args, count);
+  }
+  return applyClosure(function, args, count);
+}
+
+
+// evaluates a combination: the function, then the arguments,
+// and applies the function to the arguments
+Value *evalCombination(Value *first, Value *args, Frame *frame){
+  Value *function = eval(first, frame);
+  Value *evaledArgs = evalArgs(args, frame);
+  Value *result = apply(function, evaledArgs);
+  // the cells of the argument list die here: apply() only binds
+  // the items to parameter names, and primitives must not keep or
+  // return the cells of the list they are given
+  releaseCells(evaledArgs);
+  return result;
+}
+
+
+// Evaluates (guard (var clause ...) body ...). If evaluating the bodies
+// raises an error, var is bound to the error (see errorCondition()) and the
+// clauses are tried like those of cond: the first one whose test is true
+// (or that starts with else) gives the value of the guard. If there is
+// none, the error is raised again.
+Value *evalGuard(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE || car(args)->type != CONS_TYPE ||
+      car(car(args))->type != SYMBOL_TYPE || cdr(args)->type != CONS_TYPE){
+    evaluationError(25);
+  }
+  jmp_buf trap;
+  jmp_buf *outerTrap = errorTrap;
+  int outerDepth = callDepth;
+  errorTrap = &trap;
+  if (setjmp(trap) == 0){
+    Value *result = evalBegin(cdr(args), frame);
+    errorTrap = outerTrap;
+    return result;
+  }
+  errorTrap = outerTrap;
+  callDepth = outerDepth;
+  int type = raisedType;
+  Value *object = raisedObject;
+
+  // bind var in a new frame for the clauses
+  Value *var = car(car(args));
+  Value *binding = cons(var, cons(errorCondition(type, object), makeNull()));
+  Frame *handlerFrame = newFrame(frame);
+  handlerFrame->bindings = cons(binding, makeNull());
+
+  Value *curClause = cdr(car(args));
+  while (curClause->type != NULL_TYPE){
+    Value *clause = car(curClause);
+    if (clause->type != CONS_TYPE){
+      evaluationError(25);
+    }
+    Value *test = car(clause);
+    if (test->type == SYMBOL_TYPE && !strcmp(test->s, "else")){
+      return evalBegin(cdr(clause), handlerFrame);
+    }
+    Value *testValue = eval(test, handlerFrame);
+    if (!(testValue->type == BOOL_TYPE && testValue->i == 0)){
+      // a clause with only a test gives the value of the test
+      if (cdr(clause)->type == NULL_TYPE){
+        return testValue;
+      }
+      return evalBegin(cdr(clause), handlerFrame);
+    }
+    curClause = cdr(curClause);
+  }
+  raiseError(type, object);
+  return NULL;
+}
+
+
+// Evaluates (with-exception-handler handler thunk): calls thunk with no
+// arguments and returns its value. If the call raises an error, handler is
+// called with the error (see errorCondition()) instead, and its value is
+// returned. (Without continuations, the handler runs after the call that
+// raised the error has been abandoned, like the handler of a guard.)
+Value *evalWithExceptionHandler(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE || length(args) != 2){
+    evaluationError(26);
+  }
+  Value *handler = eval(car(args), frame);
+  Value *thunk = eval(car(cdr(args)), frame);
+  jmp_buf trap;
+  jmp_buf *outerTrap = errorTrap;
+  int outerDepth = callDepth;
+  errorTrap = &trap;
+  if (setjmp(trap) == 0){
+    Value *result = apply(thunk, makeNull());
+    errorTrap = outerTrap;
+    return result;
+  }
+  errorTrap = outerTrap;
+  callDepth = outerDepth;
+  Value *handlerArgs = cons(errorCondition(raisedType, raisedObject), makeNull());
+  Value *result = apply(handler, handlerArgs);
+  releaseCells(handlerArgs);
+  return result;
+}
+
+
+// evaluates (pcall f a b ...), which calls f with the arguments
+// a b ... like (f a b ...) does; in the parallel mode, f and the
+// arguments are evaluated in parallel if that is safe
+Value *evalPcall(Value *args, Frame *frame){
+  if (args->type != CONS_TYPE){
+    evaluationError(22);
+  }
+  if (!parallelEnabled()){
+    return evalCombination(car(args), cdr(args), frame);
+  }
+  int count = length(args);
+  Value **exprs = listToArray(args, count);
+  if (!worthParallel(exprs, count, frame)){
+    return evalCombination(car(args), cdr(args), frame);
+  }
+  EvalTask *tasks = evalInParallel(exprs, count, frame);
+  trelease(exprs, count * sizeof(Value *));
+  // build the argument list in order, like evalArgs()
+  Value *function = taskResult(&tasks[0]);
+  Value *evaledArgs = makeNull();
+  Value *lastCell = NULL;
+  for (int i = 1; i < count; i++){
+    Value *newCell = cons(taskResult(&tasks[i]), makeNull());
+    if (lastCell == NULL){
+      evaledArgs = newCell;
+    }
+    else{
+      (lastCell->c).cdr = newCell;
+    }
+    lastCell = newCell;
+  }
+  trelease(tasks, count * sizeof(EvalTask));
+  Value *result = apply(function, evaledArgs);
+  releaseCells(evaledArgs);
+  return result;
 }
 
 
 //Evaluates the S-expression referred to by expr
 //in the given frame.
 Value *eval(Value *expr, Frame *frame) {
+  // the start of eval() is the only place where the collector runs
+  gcSafepoint();
+  if (countingOn){
+    countEvents(COUNT_EVAL, 1);
+  }
+  if ((char *)__builtin_frame_address(0) < stackLimit){
+    evaluationError(51);
+  }
   switch (expr->type)  {
 
     case NULL_TYPE:
@@ -1191,6 +3192,7 @@ Value *eval(Value *expr, Frame *frame) {
     case VOID_TYPE:
     case CLOSURE_TYPE:
     case PRIMITIVE_TYPE:
+    case FUTURE_TYPE:
       break;  
 
     case INT_TYPE: 
@@ -1232,6 +3234,9 @@ Value *eval(Value *expr, Frame *frame) {
           // note: frame should be top-level frame
           return evalDefine(args, frame);
         }
+        else if (!strcmp(first->s,"define-memoized")){
+          return evalDefineMemoized(args, frame);
+        }
         else if (!strcmp(first->s,"lambda")){
           return evalLambda(args, frame);
         }
@@ -1241,23 +3246,34 @@ Value *eval(Value *expr, Frame *frame) {
         else if (!strcmp(first->s,"begin")){
           return evalBegin(args, frame);
         }
+        else if (!strcmp(first->s,"load")){
+          return evalLoad(args, frame);
+        }
         else if (!strcmp(first->s,"and")){
           return evalAnd(args, frame);
         }
         else if (!strcmp(first->s,"or")){
           return evalOr(args, frame);
         }
+        else if (!strcmp(first->s,"pcall")){
+          return evalPcall(args, frame);
+        }
+        else if (!strcmp(first->s,"future")){
+          return evalFuture(args, frame);
+        }
+        else if (!strcmp(first->s,"guard")){
+          return evalGuard(args, frame);
+        }
+        else if (!strcmp(first->s,"with-exception-handler")){
+          return evalWithExceptionHandler(args, frame);
+        }
         else {
           //combination
-          Value *function = eval(first, frame);
-          Value *evaledArgs = evalArgs(args, frame);
-          return apply(function, evaledArgs);
+          return evalCombination(first, args, frame);
         }
       }
       else{
-        Value *function = eval(first, frame);
-        Value *evaledArgs = evalArgs(args, frame);
-        return apply(function, evaledArgs);
+        return evalCombination(first, args, frame);
       }
       break;
     }
@@ -1,8 +1,71 @@
+#include <stdint.h>
+#include "value.h"
+
 #ifndef _INTERPRETER
 #define _INTERPRETER
 
 void interpret(Value *tree);
+
+// Whether a call of a primitive function has no effect besides its result
+// (see isPure() in interpreter.c)
+typedef enum {
+  IMPURE,
+  PURE,
+  // pure if the procedure it is given as its first argument is pure
+  PURE_IF_PROCEDURE_PURE
+} Purity;
+
+// A primitive function and the name makeTopFrame() binds it to
+struct Primitive {
+  const char *name;
+  Value *(*function)(Value *);
+  Purity purity;
+};
+
+typedef struct Primitive Primitive;
+
+// All primitive functions (see makeTopFrame())
+extern const Primitive primitives[];
+extern const int numPrimitives;
+
+// Returns a new top-level frame, with the primitive functions bound.
+Frame *makeTopFrame();
+
+// Interprets each top level S-expression in the tree in topFrame, which
+// keeps the definitions for the next call.
+void interpretIn(Value *tree, Frame *topFrame);
+
+// Makes interpretIn() print an error raised by a top-level form and move on
+// to the next form (if on is non-zero), instead of exiting. The heap stays
+// valid after an error, since nothing is freed.
+void setContinueAfterErrors(int on);
+
+// Makes a closure call nested in depth others raise a stack overflow error
+// (0, the default, leaves the stack as the only limit, see stack.h).
+void setMaxCallDepth(int depth);
+
+// Makes set! of a binding in frame raise an error on the calling thread
+// (NULL seals nothing), and returns the frame sealed before. Used when
+// frame is shared by programs that must not see each other's changes.
+Frame *setSealedFrame(Frame *frame);
+
+// Waits for the futures the program running on the calling thread has
+// started (see evalFuture()), so that nothing refers to them afterwards.
+void settleFutures();
 Value *eval(Value *expr, Frame *frame);
 
+// Returns non-zero if the values a and b are equal in the sense of equal?
+// (lists with equal items, strings with the same text, numbers of the same
+// type and value), and a hash that is the same for equal values.
+int valuesEqual(Value *a, Value *b);
+uint64_t valueHash(Value *value);
+
+// Constructors for evaluation results. Booleans, the void value and small
+// integers are shared Values, so the results must not be modified.
+Value *makeBool(int b);
+Value *makeVoid();
+Value *makeInt(int n);
+Value *makeDouble(double d);
+
 #endif
 
@@ -6,13 +6,17 @@
 #include "value.h"
 #include "linkedlist.h"
 #include "talloc.h"
+#include "output.h"
 
 
-// Create a new NULL_TYPE value node.
+// The empty list. Nothing modifies a NULL_TYPE Value, so every
+// list shares this one instead of allocating its own.
+Value emptyList = { .type = NULL_TYPE };
+
+
+// Return the NULL_TYPE value node.
 Value *makeNull(){
-  Value *newVal = talloc(sizeof(Value));
-  newVal->type = NULL_TYPE;
-  return newVal;
+  return &emptyList;
 }
 
 
@@ -33,16 +37,19 @@ Value *cons(Value *newCar, Value *newCdr){
 void printAtomHelper(Value val){
   switch (val.type) {
   case INT_TYPE:
-    printf("%i  ", val.i);
+    outputInt(val.i);
+    outputString("  ");
     break;
   case DOUBLE_TYPE:
-    printf("%f  ", val.d);
+    outputDouble(val.d);
+    outputString("  ");
     break;
   case STR_TYPE:
-    printf("%s  ", val.s);
+    outputBytes(val.s, val.length);
+    outputString("  ");
     break;
   case NULL_TYPE:
-    printf("NULL  ");
+    outputString("NULL  ");
     break;
   case OPEN_TYPE:
   case CLOSE_TYPE:
@@ -57,71 +64,168 @@ void printAtomHelper(Value val){
   case VOID_TYPE:
   case CLOSURE_TYPE:
   case PRIMITIVE_TYPE:
+  case FUTURE_TYPE:
     break;    
   }
   return;
 }
 
 
-// Helper Function for display():
-// does the recursion for display
-void displayRecursive(Value *list){
-  // print empty list
+// Display the contents of the linked list to the screen in some kind of
+// readable format
+// (interpreter 1): note that I assumed each node in the linked list is a cons cell
+// and I assumed that we are also displaying nested lists
+void display(Value *list){
+  // print the empty list
   if (list->type == NULL_TYPE){
-    printf("()");
+    outputString("()");
+    outputFlush();
     return;
   }
-
-  Value thisVal = *list;
-  int close = 0;
-  // if the Value is an atom, print it using a helper
-  if (thisVal.type != CONS_TYPE){
-    printAtomHelper(thisVal);
+  outputChar('(');
+  if (list->type != CONS_TYPE){
+    printAtomHelper(*list);
   }
-  // if the value is CONS_TYPE, recursively display
-  // the car and the cdr
   else{
-    // add a "(" if car points to an inner pair
-    if ((thisVal.c.car)->type == CONS_TYPE){
-      printf("(");
-      close = 1;
-    }
-    // display the car recursively
-    displayRecursive(thisVal.c.car);
-    
-    // display the cdr recursively if thisVal is not the
-    // ending node (i.e the cdr does not point to a Value
-    // whose type is NULL_TYPE)
-    if ((thisVal.c.cdr)->type != NULL_TYPE){
-      // if the cdr is an atom, add "."
-      if ((thisVal.c.cdr)->type != CONS_TYPE){
-        printf(".");
+    ListWalk walk;
+    listWalkStart(&walk, list);
+    Value *value;
+    ListEvent event;
+    while ((event = listWalkNext(&walk, &value)) != LIST_END){
+      switch (event){
+      case LIST_ITEM:
+        if (value->type == NULL_TYPE){
+          outputString("()");
+        }
+        else{
+          printAtomHelper(*value);
+        }
+        break;
+      case LIST_OPEN:
+        outputChar('(');
+        break;
+      case LIST_CLOSE:
+        outputChar(')');
+        break;
+      case LIST_TAIL:
+        outputChar('.');
+        printAtomHelper(*value);
+        break;
+      case LIST_CYCLE:
+        outputString("...");
+        break;
+      case LIST_END:
+        break;
       }
-      displayRecursive(thisVal.c.cdr);
-    }
-    // close off with ")" if needed
-    if (close == 1){
-      printf(")");
     }
+    listWalkEnd(&walk);
   }
+  outputChar(')');
+  outputFlush();
   return;
 }
 
 
-// Display the contents of the linked list to the screen in some kind of
-// readable format
-// (interpreter 1): note that I assumed each node in the linked list is a cons cell
-// and I assumed that we are also displaying nested lists
-void display(Value *list){
-  // print the empty list
-  if (list->type == NULL_TYPE){
-    printf("()");
-    return;
+// Starts a walk over the items of list (a CONS_TYPE Value).
+void listWalkStart(ListWalk *walk, Value *list){
+  assert(list->type == CONS_TYPE && "Error (listWalkStart): list is not of CONS_TYPE");
+  walk->levels = walk->firstLevels;
+  walk->capacity = sizeof(walk->firstLevels) / sizeof(ListLevel);
+  walk->depth = 1;
+  walk->levels[0].list = list;
+  walk->levels[0].rest = list;
+  walk->levels[0].lagging = list;
+  walk->levels[0].count = 0;
+}
+
+
+// Returns what comes next in the walk (see linkedlist.h).
+ListEvent listWalkNext(ListWalk *walk, Value **value){
+  if (walk->depth == 0){
+    return LIST_END;
   }
-  printf("(");
-  displayRecursive(list);
-  printf(")");
-  return;
+  ListLevel *level = &walk->levels[walk->depth - 1];
+  // (a rest of NULL means the cdrs were found to go around in a cycle)
+  if (level->rest == NULL){
+    level->rest = makeNull();
+    return LIST_CYCLE;
+  }
+  Value *rest = level->rest;
+  if (rest->type != CONS_TYPE){
+    if (rest->type != NULL_TYPE){
+      level->rest = makeNull();
+      *value = rest;
+      return LIST_TAIL;
+    }
+    walk->depth--;
+    return (walk->depth == 0) ? LIST_END : LIST_CLOSE;
+  }
+
+  // move on to the next cell, and the lagging cell every other time; the
+  // two only meet if the cdrs go around in a cycle
+  Value *item = (rest->c).car;
+  level->rest = (rest->c).cdr;
+  level->count++;
+  if ((level->count & 1) == 0){
+    level->lagging = (level->lagging->c).cdr;
+  }
+  if (level->rest == level->lagging){
+    level->rest = NULL;
+  }
+
+  if (item->type != CONS_TYPE){
+    *value = item;
+    return LIST_ITEM;
+  }
+  // likewise, comparing a nested list with the one half as deep finds a
+  // list nested in itself, without searching the whole stack
+  if (item == walk->levels[walk->depth / 2].list){
+    return LIST_CYCLE;
+  }
+  if (walk->depth == walk->capacity){
+    walk->capacity *= 2;
+    if (walk->levels == walk->firstLevels){
+      walk->levels = malloc(walk->capacity * sizeof(ListLevel));
+      assert(walk->levels != NULL && "Error (listWalkNext): out of memory");
+      memcpy(walk->levels, walk->firstLevels, sizeof(walk->firstLevels));
+    }
+    else{
+      walk->levels = realloc(walk->levels, walk->capacity * sizeof(ListLevel));
+      assert(walk->levels != NULL && "Error (listWalkNext): out of memory");
+    }
+  }
+  ListLevel *nested = &walk->levels[walk->depth];
+  nested->list = item;
+  nested->rest = item;
+  nested->lagging = item;
+  nested->count = 0;
+  walk->depth++;
+  *value = item;
+  return LIST_OPEN;
+}
+
+
+// Returns the part of the innermost list of the walk that is left.
+Value *listWalkRest(ListWalk *walk){
+  assert(walk->depth > 0 && "Error (listWalkRest): the walk has ended");
+  return walk->levels[walk->depth - 1].rest;
+}
+
+
+// Skips the rest of the innermost list of the walk.
+void listWalkSkipRest(ListWalk *walk){
+  assert(walk->depth > 0 && "Error (listWalkSkipRest): the walk has ended");
+  walk->levels[walk->depth - 1].rest = makeNull();
+}
+
+
+// Frees what the walk allocated.
+void listWalkEnd(ListWalk *walk){
+  if (walk->levels != walk->firstLevels){
+    free(walk->levels);
+  }
+  walk->levels = NULL;
+  walk->depth = 0;
 }
 
 
@@ -164,6 +268,21 @@ Value *reverse(Value *list){
 }
 
 
+// Hands the CONS_TYPE cells of a list back to talloc for reuse. The items
+// stored in the list and the final NULL_TYPE Value are left alone. Only use
+// this on a list whose cells nothing else refers to.
+void releaseCells(Value *list){
+  assert(list != NULL && "Error (releaseCells): input list is NULL");
+  while (list->type == CONS_TYPE){
+    // save the next node's address before the cell is reused
+    Value *next = (list->c).cdr;
+    trelease(list, sizeof(Value));
+    list = next;
+  }
+  return;
+}
+
+
 // Utility to make it less typing to get car value. Use assertions to make sure
 // that this is a legitimate operation.
 // Make sure have <assert.h> in your #include statements in linkedlist.c in order
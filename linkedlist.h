@@ -4,7 +4,7 @@
 #ifndef _LINKEDLIST
 #define _LINKEDLIST
 
-// Create a new NULL_TYPE value node.
+// Return the NULL_TYPE value node (shared by all lists; never modify it).
 Value *makeNull();
 
 // Create a new CONS_TYPE value node.
@@ -14,12 +14,69 @@ Value *cons(Value *newCar, Value *newCdr);
 // readable format
 void display(Value *list);
 
+// What listWalkNext() found next in a list
+typedef enum {
+  LIST_ITEM,   // an item that is not a list (possibly a NULL_TYPE Value)
+  LIST_OPEN,   // a nested list starts; its items follow
+  LIST_CLOSE,  // the innermost nested list ended
+  LIST_TAIL,   // the atom after the dot of an improper list
+  LIST_CYCLE,  // a list that contains itself: the rest would repeat
+  LIST_END     // the list given to listWalkStart() ended
+} ListEvent;
+
+// One list that a walk is in the middle of: the list, the part of it
+// left, and a cell that moves half as fast, for finding cycles
+struct ListLevel {
+  Value *list;
+  Value *rest;
+  Value *lagging;
+  unsigned long count;
+};
+
+typedef struct ListLevel ListLevel;
+
+// A walk over a list and its nested lists in printing order. It keeps an
+// explicit stack of the nested lists it is in, so it takes no C stack for
+// long or deeply nested lists, and it stops at cycles instead of looping.
+struct ListWalk {
+  ListLevel *levels;
+  int depth;
+  int capacity;
+  ListLevel firstLevels[16];
+};
+
+typedef struct ListWalk ListWalk;
+
+// Starts a walk over the items of list (a CONS_TYPE Value).
+void listWalkStart(ListWalk *walk, Value *list);
+
+// Returns what comes next in the walk. For LIST_ITEM, LIST_OPEN and
+// LIST_TAIL, *value is set to the item, nested list or tail. A list that
+// contains itself (through a cdr, or through the car of one of its cells)
+// is reported once as LIST_CYCLE instead of being walked again.
+ListEvent listWalkNext(ListWalk *walk, Value **value);
+
+// Returns the part of the innermost list of the walk that is left to walk
+// (or NULL, just before a LIST_CYCLE), and skips it: the next event is the
+// end of that list. Comparing walks over two lists uses this to skip parts
+// they share.
+Value *listWalkRest(ListWalk *walk);
+void listWalkSkipRest(ListWalk *walk);
+
+// Frees what the walk allocated.
+void listWalkEnd(ListWalk *walk);
+
 // Return a new list that is the reverse of the one that is passed in. No stored
 // data within the linked list should be duplicated; rather, a new linked list
 // of CONS_TYPE nodes should be created, that point to items in the original
 // list.
 Value *reverse(Value *list);
 
+// Hands the CONS_TYPE cells of a list back to talloc for reuse. The items
+// stored in the list and the final NULL_TYPE Value are left alone. Only use
+// this on a list whose cells nothing else refers to.
+void releaseCells(Value *list);
+
 // Utility to make it less typing to get car value. Use assertions to make sure
 // that this is a legitimate operation.
 Value *car(Value *list);
@@ -1,17 +1,235 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "tokenizer.h"
+#include "reader.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "parser.h"
 #include "talloc.h"
 #include "interpreter.h"
+#include "gc.h"
+#include "parallel.h"
+#include "interp.h"
+#include "server.h"
+#include "image.h"
+#include "parsecache.h"
+#include "counters.h"
+#include "stack.h"
 
-int main() {
+// What the command line asks for (see main()).
+struct Options {
+    gcMode mode;
+    long budgetMicros;
+    int printStats;
+    int numThreads;
+    int serve;
+    const char *socketPath;
+    const char *imagePath;
+    const char *dumpPath;
+    const char *programPath;
+    int cache;
+    // the size of the stacks to evaluate on, or 0 for the usual ones
+    size_t stackSize;
+    // the exit status of run()
+    int status;
+};
 
-    Value *list = tokenize();
-    Value *tree = parse(list);
-    interpret(tree);
+typedef struct Options Options;
 
+
+// Reads and evaluates the program (or serves programs) as options say,
+// and returns the exit status.
+static int run(Options *options) {
+    gcInit(options->mode, __builtin_frame_address(0), options->budgetMicros);
+    if (options->numThreads > 0) {
+        parallelInit(options->numThreads, options->stackSize);
+    }
+
+    if (options->serve) {
+        Interpreter *interp = interpCreate();
+        int status = 0;
+        if (options->socketPath != NULL) {
+            status = serveSocket(interp, options->socketPath);
+        }
+        else {
+            serveStream(interp, stdin, stdout);
+        }
+        interpDestroy(interp);
+        parallelShutdown();
+        tfree();
+        return status;
+    }
+
+    Frame *topFrame;
+    if (options->imagePath != NULL) {
+        topFrame = imageLoad(options->imagePath);
+        if (topFrame == NULL) {
+            parallelShutdown();
+            tfree();
+            return 1;
+        }
+    }
+    else {
+        topFrame = makeTopFrame();
+    }
+    const char *programPath = options->programPath;
+    Value *tree;
+    if (programPath == NULL) {
+        tree = readProgram(stdin);
+    }
+    else if (!options->cache) {
+        FILE *file = fopen(programPath, "r");
+        if (file == NULL) {
+            printf("Cannot read %s\n", programPath);
+            parallelShutdown();
+            tfree();
+            return 1;
+        }
+        tree = readProgram(file);
+        fclose(file);
+    }
+    else {
+        char *cachePath = malloc(strlen(programPath) + 2);
+        sprintf(cachePath, "%sc", programPath);
+        tree = parseCached(programPath, cachePath);
+        free(cachePath);
+        if (tree == NULL) {
+            printf("Cannot read %s\n", programPath);
+            parallelShutdown();
+            tfree();
+            return 1;
+        }
+    }
+    interpretIn(tree, topFrame);
+
+    int status = 0;
+    if (options->dumpPath != NULL) {
+        status = imageDump(topFrame, options->dumpPath);
+    }
+    if (options->printStats) {
+        gcPrintStats();
+    }
+    parallelShutdown();
     tfree();
-    return 0;
+    return status;
+}
+
+
+// the start function of the thread that runs the program on a stack of
+// the size given by --stack-size
+static void *runThread(void *options) {
+    ((Options *)options)->status = run((Options *)options);
+    return NULL;
+}
+
+
+// Command-line options:
+//   --gc               collect garbage, one stop-the-world pause per cycle
+//   --gc=incremental   collect garbage in short incremental pauses
+//   --gc-budget=N      pause target of one incremental step, in
+//                      microseconds (not a bound, see gc.h)
+//   --gc-stats         print collector statistics to stderr at exit
+//   --count            print event counts to stderr at exit (see counters.h)
+//   --parallel[=N]     evaluate pure expressions in parallel on N threads
+//                      (default: one per online CPU); not with --gc
+//   --keep-going       after an error in a top-level form, print it and
+//                      go on with the next form
+//   --stack-size=MB    evaluate on stacks of MB megabytes (see stack.h),
+//                      for the program and the --parallel workers
+//   --max-depth=N      raise a stack overflow error when closure calls
+//                      nest more than N deep
+//   --serve            serve programs read from stdin (see server.h)
+//   --serve=PATH       serve programs sent to a Unix domain socket at PATH
+//   --image=PATH       start from the top-level frame saved in an image
+//   --dump-image=PATH  after the program, save its top-level frame as an
+//                      image (see image.h)
+//   --cache            keep the parse tree of the program file in a cache
+//                      file next to it, PROGRAMc (see parsecache.h)
+// The program is read from the file named by the first other argument, or
+// from stdin if there is none.
+int main(int argc, char *argv[]) {
+    Options options = {.mode = GC_OFF, .budgetMicros = 500};
+    int usageError = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--gc")) {
+            options.mode = GC_STOP_THE_WORLD;
+        }
+        else if (!strcmp(argv[i], "--gc=incremental")) {
+            options.mode = GC_INCREMENTAL;
+        }
+        else if (!strncmp(argv[i], "--gc-budget=", 12)) {
+            options.budgetMicros = atol(argv[i] + 12);
+        }
+        else if (!strcmp(argv[i], "--gc-stats")) {
+            options.printStats = 1;
+        }
+        else if (!strcmp(argv[i], "--count")) {
+            countersEnable();
+        }
+        else if (!strcmp(argv[i], "--keep-going")) {
+            setContinueAfterErrors(1);
+        }
+        else if (!strncmp(argv[i], "--stack-size=", 13) && atol(argv[i] + 13) >= 1) {
+            options.stackSize = (size_t)atol(argv[i] + 13) << 20;
+        }
+        else if (!strncmp(argv[i], "--max-depth=", 12) && atoi(argv[i] + 12) >= 1) {
+            setMaxCallDepth(atoi(argv[i] + 12));
+        }
+        else if (!strcmp(argv[i], "--parallel")) {
+            options.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        else if (!strncmp(argv[i], "--parallel=", 11) && atoi(argv[i] + 11) >= 1) {
+            options.numThreads = atoi(argv[i] + 11);
+        }
+        else if (!strcmp(argv[i], "--serve")) {
+            options.serve = 1;
+        }
+        else if (!strncmp(argv[i], "--serve=", 8) && argv[i][8] != '\0') {
+            options.serve = 1;
+            options.socketPath = argv[i] + 8;
+        }
+        else if (!strncmp(argv[i], "--image=", 8) && argv[i][8] != '\0') {
+            options.imagePath = argv[i] + 8;
+        }
+        else if (!strncmp(argv[i], "--dump-image=", 13) && argv[i][13] != '\0') {
+            options.dumpPath = argv[i] + 13;
+        }
+        else if (!strcmp(argv[i], "--cache")) {
+            options.cache = 1;
+        }
+        else if (argv[i][0] != '-' && options.programPath == NULL) {
+            options.programPath = argv[i];
+        }
+        else {
+            usageError = 1;
+        }
+    }
+    if (usageError) {
+        printf("Usage: %s [--gc | --gc=incremental] [--gc-budget=N] [--gc-stats] [--count] [--parallel[=N]] [--keep-going] [--stack-size=MB] [--max-depth=N] [--serve[=PATH]] [--image=PATH] [--dump-image=PATH] [--cache] [program.scm | < program.scm]\n", argv[0]);
+        return 1;
+    }
+    // the collector only scans the stack of the evaluating thread
+    if (options.numThreads > 0 && options.mode != GC_OFF) {
+        printf("--parallel cannot be combined with --gc\n");
+        return 1;
+    }
+    if (options.serve && (options.imagePath != NULL || options.dumpPath != NULL ||
+                          options.programPath != NULL)) {
+        printf("--serve cannot be combined with --image, --dump-image or a program file\n");
+        return 1;
+    }
+    if (options.cache && options.programPath == NULL) {
+        printf("--cache needs a program file\n");
+        return 1;
+    }
+    if (options.stackSize == 0) {
+        return run(&options);
+    }
+    if (runOnStack(options.stackSize, runThread, &options) != 0) {
+        printf("Cannot make a stack of %zu megabytes\n", options.stackSize >> 20);
+        return 1;
+    }
+    return options.status;
 }
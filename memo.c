@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "value.h"
+#include "talloc.h"
+#include "interpreter.h"
+#include "gc.h"
+#include "memo.h"
+
+
+// One cached call. Entries are numbered by their index in the entries array
+// of the memo; -1 ends a chain.
+struct MemoEntry {
+  uint64_t hash;
+  Value **args;
+  int count;
+  Value *result;
+  // the next entry in the same bucket
+  int nextInBucket;
+  // the neighbours in the list of entries from most to least recently used
+  int newer;
+  int older;
+};
+
+typedef struct MemoEntry MemoEntry;
+
+// The entries array grows by doubling up to capacity, so a memo with a
+// large capacity only takes the memory of the results it holds. buckets has
+// twice as many slots as the entries array (a power of 2), each the first
+// entry of a chain or -1.
+struct Memo {
+  Heap *heap;
+  int capacity;
+  int count;
+  long hits;
+  long misses;
+  MemoEntry *entries;
+  int entriesCapacity;
+  int *buckets;
+  int numBuckets;
+  int newest;
+  int oldest;
+};
+
+static pthread_mutex_t memoLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Returns an empty memo for at most capacity results.
+Memo *memoCreate(int capacity){
+  Memo *memo = talloc(sizeof(Memo));
+  memo->heap = activeHeap();
+  memo->capacity = capacity;
+  memo->count = 0;
+  memo->hits = 0;
+  memo->misses = 0;
+  memo->entries = NULL;
+  memo->entriesCapacity = 0;
+  memo->buckets = NULL;
+  memo->numBuckets = 0;
+  memo->newest = -1;
+  memo->oldest = -1;
+  return memo;
+}
+
+
+// returns the hash of a call with the count values in args
+static uint64_t argsHash(Value **args, int count){
+  uint64_t hash = 14695981039346656037ULL ^ (uint64_t)count;
+  for (int i = 0; i < count; i++){
+    hash = (hash ^ valueHash(args[i])) * 1099511628211ULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+
+// returns the entry of memo for a call with args, or -1
+static int findEntry(Memo *memo, Value **args, int count, uint64_t hash){
+  if (memo->numBuckets == 0){
+    return -1;
+  }
+  int index = memo->buckets[hash & (memo->numBuckets - 1)];
+  while (index != -1){
+    MemoEntry *entry = &memo->entries[index];
+    if (entry->hash == hash && entry->count == count){
+      int i = 0;
+      while (i < count && valuesEqual(entry->args[i], args[i])){
+        i++;
+      }
+      if (i == count){
+        return index;
+      }
+    }
+    index = entry->nextInBucket;
+  }
+  return -1;
+}
+
+
+// takes entry index out of the recency list of memo
+static void unlinkRecent(Memo *memo, int index){
+  MemoEntry *entry = &memo->entries[index];
+  if (entry->newer == -1){
+    memo->newest = entry->older;
+  }
+  else{
+    memo->entries[entry->newer].older = entry->older;
+  }
+  if (entry->older == -1){
+    memo->oldest = entry->newer;
+  }
+  else{
+    memo->entries[entry->older].newer = entry->newer;
+  }
+}
+
+
+// puts entry index at the front of the recency list of memo
+static void linkNewest(Memo *memo, int index){
+  MemoEntry *entry = &memo->entries[index];
+  entry->newer = -1;
+  entry->older = memo->newest;
+  if (memo->newest == -1){
+    memo->oldest = index;
+  }
+  else{
+    memo->entries[memo->newest].newer = index;
+  }
+  memo->newest = index;
+}
+
+
+// If memo holds the result of a call with args, stores it in *result and
+// returns 1; otherwise returns 0. *hash is set for memoStore() either way.
+int memoLookup(Memo *memo, Value **args, int count, uint64_t *hash, Value **result){
+  if (memo->heap != activeHeap()){
+    return 0;
+  }
+  *hash = argsHash(args, count);
+  pthread_mutex_lock(&memoLock);
+  int index = findEntry(memo, args, count, *hash);
+  if (index == -1){
+    memo->misses++;
+    pthread_mutex_unlock(&memoLock);
+    return 0;
+  }
+  memo->hits++;
+  if (memo->newest != index){
+    unlinkRecent(memo, index);
+    linkNewest(memo, index);
+  }
+  *result = memo->entries[index].result;
+  pthread_mutex_unlock(&memoLock);
+  return 1;
+}
+
+
+// doubles the entries array of memo (up to its capacity) and rebuilds the
+// buckets for the new size
+static void growEntries(Memo *memo){
+  int newCapacity = (memo->entriesCapacity == 0) ? 16 : memo->entriesCapacity * 2;
+  if (newCapacity > memo->capacity){
+    newCapacity = memo->capacity;
+  }
+  MemoEntry *entries = talloc(newCapacity * sizeof(MemoEntry));
+  if (memo->count > 0){
+    memcpy(entries, memo->entries, memo->count * sizeof(MemoEntry));
+  }
+  int numBuckets = 1;
+  while (numBuckets < 2 * newCapacity){
+    numBuckets *= 2;
+  }
+  int *buckets = talloc(numBuckets * sizeof(int));
+  for (int i = 0; i < numBuckets; i++){
+    buckets[i] = -1;
+  }
+  for (int i = 0; i < memo->count; i++){
+    int bucket = entries[i].hash & (numBuckets - 1);
+    entries[i].nextInBucket = buckets[bucket];
+    buckets[bucket] = i;
+  }
+  if (memo->entries != NULL){
+    trelease(memo->entries, memo->entriesCapacity * sizeof(MemoEntry));
+    trelease(memo->buckets, memo->numBuckets * sizeof(int));
+  }
+  gcWriteBarrier(entries);
+  memo->entries = entries;
+  gcWriteBarrier(buckets);
+  memo->buckets = buckets;
+  memo->entriesCapacity = newCapacity;
+  memo->numBuckets = numBuckets;
+}
+
+
+// takes entry index out of its bucket chain
+static void unlinkBucket(Memo *memo, int index){
+  int *link = &memo->buckets[memo->entries[index].hash & (memo->numBuckets - 1)];
+  while (*link != index){
+    link = &memo->entries[*link].nextInBucket;
+  }
+  *link = memo->entries[index].nextInBucket;
+}
+
+
+// Adds the result of a call with args, dropping the least recently used
+// entry if memo is full.
+void memoStore(Memo *memo, Value **args, int count, uint64_t hash, Value *result){
+  if (memo->heap != activeHeap()){
+    return;
+  }
+  // the copy of args is made before locking, and dropped if another thread
+  // stored the same call in the meantime
+  Value **argsCopy = talloc((count == 0 ? 1 : count) * sizeof(Value *));
+  memcpy(argsCopy, args, count * sizeof(Value *));
+  pthread_mutex_lock(&memoLock);
+  if (findEntry(memo, args, count, hash) != -1){
+    pthread_mutex_unlock(&memoLock);
+    trelease(argsCopy, (count == 0 ? 1 : count) * sizeof(Value *));
+    return;
+  }
+  int index;
+  if (memo->count == memo->capacity){
+    // reuse the least recently used entry
+    index = memo->oldest;
+    MemoEntry *old = &memo->entries[index];
+    unlinkBucket(memo, index);
+    unlinkRecent(memo, index);
+    trelease(old->args, (old->count == 0 ? 1 : old->count) * sizeof(Value *));
+  }
+  else{
+    if (memo->count == memo->entriesCapacity){
+      growEntries(memo);
+    }
+    index = memo->count;
+    memo->count++;
+  }
+  MemoEntry *entry = &memo->entries[index];
+  int bucket = hash & (memo->numBuckets - 1);
+  entry->hash = hash;
+  gcWriteBarrier(argsCopy);
+  entry->args = argsCopy;
+  entry->count = count;
+  gcWriteBarrier(result);
+  entry->result = result;
+  entry->nextInBucket = memo->buckets[bucket];
+  memo->buckets[bucket] = index;
+  linkNewest(memo, index);
+  pthread_mutex_unlock(&memoLock);
+}
+
+
+// Stores the hit and miss counts and the number of results held.
+void memoStats(Memo *memo, long *hits, long *misses, int *size){
+  pthread_mutex_lock(&memoLock);
+  *hits = memo->hits;
+  *misses = memo->misses;
+  *size = memo->count;
+  pthread_mutex_unlock(&memoLock);
+}
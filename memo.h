@@ -0,0 +1,39 @@
+#include "value.h"
+
+#ifndef _MEMO
+#define _MEMO
+
+// The cache of a memoized closure (see memoize and define-memoized in
+// interpreter.c): the results of its calls, keyed by the argument values
+// (compared with equal?), in a hash table that keeps at most a fixed number
+// of entries and drops the least recently used one to make room.
+//
+// A memo is talloc'd from the heap of the interpreter that created it, and
+// only calls made with that heap active use it, so the heap never refers to
+// argument values of another heap (e.g. of an isolated script, see interp.h).
+// All memos share one lock, so several threads may use a memo at the same
+// time; the parallel mode never runs calls of a memoized closure in parallel
+// though (they are impure, see isPure() in interpreter.c), so that the hits
+// and misses counted are those of a serial run.
+typedef struct Memo Memo;
+
+// Returns an empty memo for at most capacity results (capacity > 0).
+Memo *memoCreate(int capacity);
+
+// If memo holds the result of a call with the count values in args, stores
+// it in *result and returns 1. Otherwise returns 0, and the caller computes
+// the result and hands it to memoStore() with the same args and *hash.
+// Returns 0 without counting a miss if memo can't be used by the calling
+// thread (its heap is not active).
+int memoLookup(Memo *memo, Value **args, int count, uint64_t *hash, Value **result);
+
+// Adds the result of a call with the count values in args (whose hash
+// memoLookup() returned), dropping the least recently used entry if memo is
+// full. The args array is copied; the values are kept as they are.
+void memoStore(Memo *memo, Value **args, int count, uint64_t hash, Value *result);
+
+// Stores the number of lookups that found a result and that didn't, and the
+// number of results held.
+void memoStats(Memo *memo, long *hits, long *misses, int *size);
+
+#endif
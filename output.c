@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "parser.h"
+#include "output.h"
+
+#define OUTPUT_BUFFER_SIZE (32 * 1024)
+
+// the calling thread's output buffer, and the number of bytes it holds
+_Thread_local char outputBuffer[OUTPUT_BUFFER_SIZE];
+_Thread_local size_t outputUsed = 0;
+
+
+// Writes what the buffer holds to outputStream() and empties it.
+void outputFlush(){
+  if (outputUsed != 0){
+    fwrite(outputBuffer, 1, outputUsed, outputStream());
+    outputUsed = 0;
+  }
+}
+
+
+// Appends the length bytes at bytes to the buffer.
+void outputBytes(const char *bytes, size_t length){
+  if (outputUsed + length > OUTPUT_BUFFER_SIZE){
+    outputFlush();
+    if (length > OUTPUT_BUFFER_SIZE){
+      fwrite(bytes, 1, length, outputStream());
+      return;
+    }
+  }
+  memcpy(outputBuffer + outputUsed, bytes, length);
+  outputUsed += length;
+}
+
+
+// Appends a character to the buffer.
+void outputChar(char c){
+  if (outputUsed == OUTPUT_BUFFER_SIZE){
+    outputFlush();
+  }
+  outputBuffer[outputUsed] = c;
+  outputUsed++;
+}
+
+
+// Appends a NUL-terminated string to the buffer.
+void outputString(const char *s){
+  outputBytes(s, strlen(s));
+}
+
+
+// Appends n in decimal.
+void outputInt(long n){
+  // the digits are produced from the last one backwards
+  char digits[24];
+  char *start = digits + sizeof(digits);
+  unsigned long magnitude = (n < 0) ? -(unsigned long)n : (unsigned long)n;
+  do {
+    start--;
+    *start = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (n < 0){
+    start--;
+    *start = '-';
+  }
+  outputBytes(start, digits + sizeof(digits) - start);
+}
+
+
+// Appends d with six digits after the decimal point.
+void outputDouble(double d){
+  // The digits come from |d| * 10^6 rounded to an integer. The product
+  // is off by at most an ulp of itself, so that rounds the same way as the
+  // exact value unless d is huge (or not a number), or the product lies
+  // within an ulp of halfway between two integers; printf handles those.
+  double scaled = fabs(d) * 1e6;
+  int rounded = scaled < 1e15;
+  unsigned long long micros = 0;
+  if (rounded){
+    micros = (unsigned long long)scaled;
+    double fraction = scaled - (double)micros;
+    rounded = fabs(fraction - 0.5) > scaled * 0x1p-52;
+    if (fraction > 0.5){
+      micros++;
+    }
+  }
+  if (!rounded){
+    char text[512];
+    int length = snprintf(text, sizeof(text), "%f", d);
+    outputBytes(text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    return;
+  }
+  // printf keeps the sign of values that round to zero
+  if (signbit(d)){
+    outputChar('-');
+  }
+  outputInt((long)(micros / 1000000));
+  char digits[8] = ".000000";
+  unsigned long long fractionDigits = micros % 1000000;
+  for (int i = 6; i >= 1; i--){
+    digits[i] = (char)('0' + fractionDigits % 10);
+    fractionDigits /= 10;
+  }
+  outputBytes(digits, 7);
+}
@@ -0,0 +1,30 @@
+#include <stddef.h>
+
+#ifndef _OUTPUT
+#define _OUTPUT
+
+// Everything the interpreter prints goes through a byte buffer of the
+// calling thread, which is written to outputStream() (see parser.h) in one
+// call at each flush point instead of one formatted stdio call per atom.
+// The buffer flushes itself when it is full, and anything longer than the
+// buffer is written straight through. Output that must appear in order with
+// other writes to the stream is flushed explicitly: after each top-level
+// form, before an error message, and when the thread's output stream
+// changes.
+
+// Appends a character, a NUL-terminated string, or the length bytes at
+// bytes to the buffer.
+void outputChar(char c);
+void outputString(const char *s);
+void outputBytes(const char *bytes, size_t length);
+
+// Appends n in decimal, like printf's "%i".
+void outputInt(long n);
+
+// Appends d with six digits after the decimal point, like printf's "%f".
+void outputDouble(double d);
+
+// Writes what the buffer holds to outputStream() and empties it.
+void outputFlush();
+
+#endif
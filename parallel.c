@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include "parallel.h"
+
+
+// Each deque is a growable ring buffer of tasks guarded by its own lock.
+// The owner works at the bottom (LIFO, good for locality); thieves take
+// from the top (the oldest, usually biggest, tasks).
+struct Deque {
+  pthread_mutex_t lock;
+  Task **tasks;
+  long top;
+  long bottom;
+  long capacity;
+};
+
+typedef struct Deque Deque;
+
+
+static int numDeques = 0;
+static Deque *deques = NULL;
+static pthread_t *workers = NULL;
+
+// the index of the calling thread's deque (the thread that
+// called parallelInit() owns deque 0)
+static _Thread_local int myDeque = 0;
+
+// idle workers sleep on workAvailable until a task is queued
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workAvailable = PTHREAD_COND_INITIALIZER;
+static int queuedTasks = 0;
+static int shuttingDown = 0;
+
+// the task group of threads that have not set one
+static TaskGroup defaultGroup = {0};
+static _Thread_local TaskGroup *myGroup = NULL;
+
+
+// pushes a task at the bottom of a deque, growing it if needed
+static void pushBottom(Deque *deque, Task *task){
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom - deque->top == deque->capacity){
+    long newCapacity = (deque->capacity == 0) ? 64 : deque->capacity * 2;
+    Task **newTasks = malloc(newCapacity * sizeof(Task *));
+    assert(newTasks != NULL && "Error (spawnTask): out of memory");
+    for (long i = deque->top; i < deque->bottom; i++){
+      newTasks[i % newCapacity] = deque->tasks[i % deque->capacity];
+    }
+    free(deque->tasks);
+    deque->tasks = newTasks;
+    deque->capacity = newCapacity;
+  }
+  deque->tasks[deque->bottom % deque->capacity] = task;
+  deque->bottom++;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+
+// takes the newest task of a deque (fromBottom) or the oldest one
+// (!fromBottom); returns NULL if the deque is empty
+static Task *take(Deque *deque, int fromBottom){
+  Task *task = NULL;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom > deque->top){
+    if (fromBottom){
+      deque->bottom--;
+      task = deque->tasks[deque->bottom % deque->capacity];
+    }
+    else{
+      task = deque->tasks[deque->top % deque->capacity];
+      deque->top++;
+    }
+  }
+  pthread_mutex_unlock(&deque->lock);
+  if (task != NULL){
+    __atomic_fetch_sub(&queuedTasks, 1, __ATOMIC_SEQ_CST);
+  }
+  return task;
+}
+
+
+// finds a task to run: first from the thread's own deque,
+// then by stealing from the others
+static Task *findTask(){
+  Task *task = take(&deques[myDeque], 1);
+  for (int i = 1; task == NULL && i < numDeques; i++){
+    task = take(&deques[(myDeque + i) % numDeques], 0);
+  }
+  return task;
+}
+
+
+// runs a task taken from a deque, in its group, and marks it done
+static void runTask(Task *task){
+  TaskGroup *outerGroup = myGroup;
+  myGroup = task->group;
+  task->run(task);
+  myGroup = outerGroup;
+  // (read before done is set, after which the task may be gone)
+  TaskGroup *group = task->group;
+  __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+  __atomic_fetch_sub(&group->pending, 1, __ATOMIC_SEQ_CST);
+}
+
+
+// the loop of a worker thread: run tasks, or sleep until there are some
+static void *workerLoop(void *arg){
+  myDeque = (int)(long)arg;
+  while (1){
+    Task *task = findTask();
+    if (task != NULL){
+      runTask(task);
+      continue;
+    }
+    pthread_mutex_lock(&sleepLock);
+    while (__atomic_load_n(&queuedTasks, __ATOMIC_SEQ_CST) == 0 && !shuttingDown){
+      pthread_cond_wait(&workAvailable, &sleepLock);
+    }
+    int stop = shuttingDown;
+    pthread_mutex_unlock(&sleepLock);
+    if (stop){
+      return NULL;
+    }
+  }
+}
+
+
+// Starts the work-stealing thread pool with numThreads threads in total.
+void parallelInit(int numThreads, size_t stackSize){
+  assert(numThreads >= 1 && "Error (parallelInit): need at least one thread");
+  numDeques = numThreads;
+  deques = calloc(numDeques, sizeof(Deque));
+  workers = calloc(numDeques, sizeof(pthread_t));
+  assert(deques != NULL && workers != NULL && "Error (parallelInit): out of memory");
+  for (int i = 0; i < numDeques; i++){
+    pthread_mutex_init(&deques[i].lock, NULL);
+  }
+  myDeque = 0;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (stackSize != 0){
+    pthread_attr_setstacksize(&attr, stackSize);
+  }
+  for (int i = 1; i < numDeques; i++){
+    pthread_create(&workers[i], &attr, workerLoop, (void *)(long)i);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+
+// Stops and joins the workers.
+void parallelShutdown(){
+  if (deques == NULL){
+    return;
+  }
+  pthread_mutex_lock(&sleepLock);
+  shuttingDown = 1;
+  pthread_cond_broadcast(&workAvailable);
+  pthread_mutex_unlock(&sleepLock);
+  for (int i = 1; i < numDeques; i++){
+    pthread_join(workers[i], NULL);
+  }
+  for (int i = 0; i < numDeques; i++){
+    pthread_mutex_destroy(&deques[i].lock);
+    free(deques[i].tasks);
+  }
+  free(deques);
+  free(workers);
+  deques = NULL;
+  workers = NULL;
+  numDeques = 0;
+  shuttingDown = 0;
+}
+
+
+// Returns non-zero if the thread pool is running.
+int parallelEnabled(){
+  return deques != NULL;
+}
+
+
+// Returns the number of threads of the thread pool (0 if it is not running).
+int parallelNumThreads(){
+  return numDeques;
+}
+
+
+// Pushes a task onto the calling thread's deque.
+void spawnTask(Task *task){
+  task->done = 0;
+  task->group = (myGroup != NULL) ? myGroup : &defaultGroup;
+  __atomic_fetch_add(&task->group->pending, 1, __ATOMIC_SEQ_CST);
+  __atomic_fetch_add(&queuedTasks, 1, __ATOMIC_SEQ_CST);
+  pushBottom(&deques[myDeque], task);
+  pthread_mutex_lock(&sleepLock);
+  pthread_cond_signal(&workAvailable);
+  pthread_mutex_unlock(&sleepLock);
+}
+
+
+// Returns once task is done, running other tasks while waiting.
+void waitForTask(Task *task){
+  while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)){
+    Task *other = findTask();
+    if (other != NULL){
+      runTask(other);
+    }
+    else{
+      // the task is being run by another thread
+      sched_yield();
+    }
+  }
+}
+
+
+// Makes group the task group of the calling thread.
+TaskGroup *setTaskGroup(TaskGroup *group){
+  TaskGroup *oldGroup = myGroup;
+  myGroup = group;
+  return oldGroup;
+}
+
+
+// Returns once no task of the calling thread's group is queued or running,
+// running tasks (of any group) while waiting.
+void waitForTaskGroup(){
+  TaskGroup *group = (myGroup != NULL) ? myGroup : &defaultGroup;
+  while (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0){
+    Task *task = findTask();
+    if (task != NULL){
+      runTask(task);
+    }
+    else{
+      sched_yield();
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#include <stddef.h>
+
+#ifndef _PARALLEL
+#define _PARALLEL
+
+// A set of tasks that can be waited for without waiting for the tasks of
+// others, e.g. those of one interpreter context (see interp.h). pending is
+// the number of its tasks spawned and not yet done.
+struct TaskGroup {
+  int pending;
+};
+
+typedef struct TaskGroup TaskGroup;
+
+// A unit of work for the thread pool. run is called with the task itself,
+// on whichever thread gets to it first; done is set once it has returned.
+// spawnTask() puts it in the task group of the spawning thread, which is
+// also the group of the thread while it runs the task.
+struct Task {
+  void (*run)(struct Task *task);
+  void *data;
+  volatile int done;
+  TaskGroup *group;
+};
+
+typedef struct Task Task;
+
+// Starts the work-stealing thread pool with numThreads threads in total
+// (the calling thread plus numThreads - 1 workers). Each thread owns a deque
+// of tasks: it pushes and pops its own tasks at the bottom, and idle threads
+// steal from the top of the others' deques. The workers' stacks are
+// stackSize bytes, or the default size if it is 0.
+void parallelInit(int numThreads, size_t stackSize);
+
+// Stops and joins the workers.
+void parallelShutdown();
+
+// Returns non-zero if the thread pool is running.
+int parallelEnabled();
+
+// Returns the number of threads of the thread pool (0 if it is not running).
+int parallelNumThreads();
+
+// Pushes a task onto the calling thread's deque.
+void spawnTask(Task *task);
+
+// Returns once task is done. While waiting, the calling thread runs tasks
+// from its own deque or steals them from others, so waiting never blocks a
+// thread that could be doing useful work.
+void waitForTask(Task *task);
+
+// Makes group (NULL for the default group, that the threads start in) the
+// task group of the calling thread, and returns the one it was in before.
+TaskGroup *setTaskGroup(TaskGroup *group);
+
+// Returns once no task of the calling thread's group is queued or running
+// (e.g. futures that were never touched), running tasks while waiting. Must
+// not be called from a task of the group.
+void waitForTaskGroup();
+
+#endif
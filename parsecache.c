@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "value.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "tokenizer.h"
+#include "parser.h"
+#include "ptrtable.h"
+#include "parsecache.h"
+#include "text.h"
+
+// Layout of a cache file: the header, then the doubles, the integers, the
+// text offsets of the symbols and of the strings, the lengths of the
+// strings (which may hold NUL bytes), the cells (two indices each) and the
+// text, where each symbol and string is followed by a NUL byte. The Values
+// of a tree are numbered in the same order, with #f and #t between the
+// strings and the cells; NO_VALUE stands for the empty list. A cell comes
+// after its car and cdr, so a tree read back can't hold a cycle, and
+// payloadHash covers everything after the header, so a damaged file is
+// parsed again instead of running as some other program.
+#define CACHE_MAGIC "SCMPRS2"
+#define NO_VALUE UINT32_MAX
+
+struct CacheHeader {
+  char magic[8];
+  uint64_t sourceHash;
+  uint64_t sourceLength;
+  uint32_t numDoubles;
+  uint32_t numInts;
+  uint32_t numSymbols;
+  uint32_t numStrings;
+  uint32_t numCells;
+  uint32_t textSize;
+  uint32_t root;
+  uint32_t unused;
+  uint64_t payloadHash;
+};
+
+typedef struct CacheHeader CacheHeader;
+
+// the pools of a tree, in the order its Values are numbered
+typedef enum {
+  DOUBLE_POOL,
+  INT_POOL,
+  SYMBOL_POOL,
+  STRING_POOL,
+  BOOL_POOL,
+  CELL_POOL,
+  NUM_POOLS
+} poolKind;
+
+
+// A Value collect() has yet to visit, or (if expanded) a cell whose car and
+// cdr it has visited, which gets its number next
+struct PendingValue {
+  Value *value;
+  int expanded;
+};
+
+typedef struct PendingValue PendingValue;
+
+// The state of writing a cache: the Values of each pool in the order they
+// were found, the number of the first Value of each pool, a table from
+// the address of each Value found to its pool and its index in the pool,
+// and the worklist of collect()
+struct CacheWriter {
+  Value **pools[NUM_POOLS];
+  uint32_t counts[NUM_POOLS];
+  uint32_t capacities[NUM_POOLS];
+  uint32_t firsts[NUM_POOLS];
+  PointerTable found;
+  int unsupported;
+  PendingValue *pending;
+  size_t numPending;
+  size_t pendingCapacity;
+};
+
+typedef struct CacheWriter CacheWriter;
+
+
+// returns the FNV-1a hash of the length bytes at source
+static uint64_t hashSource(const char *source, size_t length){
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++){
+    hash = (hash ^ (unsigned char)source[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// returns the pool that holds value
+static poolKind poolOf(Value *value){
+  switch (value->type){
+  case DOUBLE_TYPE:
+    return DOUBLE_POOL;
+  case INT_TYPE:
+    return INT_POOL;
+  case SYMBOL_TYPE:
+    return SYMBOL_POOL;
+  case STR_TYPE:
+    return STRING_POOL;
+  case BOOL_TYPE:
+    return BOOL_POOL;
+  default:
+    return CELL_POOL;
+  }
+}
+
+
+// adds value to its pool
+static void addToPool(CacheWriter *writer, Value *value){
+  poolKind pool = poolOf(value);
+  if (writer->counts[pool] == writer->capacities[pool]){
+    writer->capacities[pool] = (writer->capacities[pool] == 0) ? 256 : writer->capacities[pool] * 2;
+    writer->pools[pool] = realloc(writer->pools[pool], writer->capacities[pool] * sizeof(Value *));
+    assert(writer->pools[pool] != NULL && "Error (parsecache): out of memory");
+  }
+  pointerTablePut(&writer->found, value, ((uint64_t)pool << 32) | writer->counts[pool]);
+  writer->pools[pool][writer->counts[pool]] = value;
+  writer->counts[pool]++;
+}
+
+
+// adds value to the worklist of collect()
+static void pushPending(CacheWriter *writer, Value *value, int expanded){
+  if (writer->numPending == writer->pendingCapacity){
+    writer->pendingCapacity = (writer->pendingCapacity == 0) ? 256 : writer->pendingCapacity * 2;
+    writer->pending = realloc(writer->pending, writer->pendingCapacity * sizeof(PendingValue));
+    assert(writer->pending != NULL && "Error (parsecache): out of memory");
+  }
+  writer->pending[writer->numPending].value = value;
+  writer->pending[writer->numPending].expanded = expanded;
+  writer->numPending++;
+}
+
+
+// adds every Value of tree that isn't in a pool yet to its pool, each cell
+// after its car and cdr (with a worklist rather than recursion, as a tree
+// can be nested deeper than the C stack allows)
+static void collect(CacheWriter *writer, Value *tree){
+  pushPending(writer, tree, 0);
+  while (writer->numPending > 0 && !writer->unsupported){
+    writer->numPending--;
+    PendingValue next = writer->pending[writer->numPending];
+    Value *value = next.value;
+    uint64_t found;
+    if (value->type == NULL_TYPE || value->type == BOOL_TYPE ||
+        pointerTableGet(&writer->found, value, &found)){
+      continue;
+    }
+    if (next.expanded){
+      addToPool(writer, value);
+    }
+    else if (value->type == CONS_TYPE){
+      // the car is visited first, then the cdr, then the cell itself
+      pushPending(writer, value, 1);
+      pushPending(writer, cdr(value), 0);
+      pushPending(writer, car(value), 0);
+    }
+    else if (value->type == DOUBLE_TYPE || value->type == INT_TYPE ||
+             value->type == SYMBOL_TYPE || value->type == STR_TYPE){
+      addToPool(writer, value);
+    }
+    else{
+      writer->unsupported = 1;
+    }
+  }
+  free(writer->pending);
+  writer->pending = NULL;
+  writer->numPending = 0;
+  writer->pendingCapacity = 0;
+}
+
+
+// returns the length of the text of atom (a symbol or a string), without
+// the NUL byte that follows it in a cache
+static size_t textLength(Value *atom){
+  return (atom->type == STR_TYPE) ? (size_t)atom->length : strlen(atom->s);
+}
+
+
+// returns the number of a Value that collect() has added to its pool
+static uint32_t numberOf(CacheWriter *writer, Value *value){
+  if (value->type == NULL_TYPE){
+    return NO_VALUE;
+  }
+  if (value->type == BOOL_TYPE){
+    return writer->firsts[BOOL_POOL] + (value->i != 0);
+  }
+  uint64_t found;
+  pointerTableGet(&writer->found, value, &found);
+  return writer->firsts[found >> 32] + (uint32_t)found;
+}
+
+
+// appends size bytes at data to the malloc'd buffer *bytes, which holds
+// *used bytes and has room for *capacity
+static void append(char **bytes, size_t *used, size_t *capacity, const void *data, size_t size){
+  while (*used + size > *capacity){
+    *capacity *= 2;
+    *bytes = realloc(*bytes, *capacity);
+    assert(*bytes != NULL && "Error (parsecache): out of memory");
+  }
+  memcpy(*bytes + *used, data, size);
+  *used += size;
+}
+
+
+// Returns tree in the cache format (*size bytes, in a malloc'd buffer), as
+// the tree of the source with the given hash and length, or NULL if tree
+// holds a Value no pool can hold.
+static char *encodeTree(Value *tree, uint64_t hash, size_t length, size_t *size){
+  CacheWriter writer;
+  memset(&writer, 0, sizeof(writer));
+  pointerTableInit(&writer.found);
+  collect(&writer, tree);
+  char *bytes = NULL;
+  if (!writer.unsupported){
+    uint32_t first = 0;
+    for (int pool = 0; pool < NUM_POOLS; pool++){
+      writer.firsts[pool] = first;
+      first += (pool == BOOL_POOL) ? 2 : writer.counts[pool];
+    }
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.sourceHash = hash;
+    header.sourceLength = length;
+    header.numDoubles = writer.counts[DOUBLE_POOL];
+    header.numInts = writer.counts[INT_POOL];
+    header.numSymbols = writer.counts[SYMBOL_POOL];
+    header.numStrings = writer.counts[STRING_POOL];
+    header.numCells = writer.counts[CELL_POOL];
+    header.root = numberOf(&writer, tree);
+    uint32_t numTexts = header.numSymbols + header.numStrings;
+    for (uint32_t i = 0; i < numTexts; i++){
+      Value *atom = (i < header.numSymbols) ? writer.pools[SYMBOL_POOL][i] :
+        writer.pools[STRING_POOL][i - header.numSymbols];
+      header.textSize += textLength(atom) + 1;
+    }
+
+    size_t capacity = 4096;
+    *size = 0;
+    bytes = malloc(capacity);
+    assert(bytes != NULL && "Error (parsecache): out of memory");
+    append(&bytes, size, &capacity, &header, sizeof(header));
+    for (uint32_t i = 0; i < header.numDoubles; i++){
+      append(&bytes, size, &capacity, &writer.pools[DOUBLE_POOL][i]->d, sizeof(double));
+    }
+    for (uint32_t i = 0; i < header.numInts; i++){
+      int32_t n = writer.pools[INT_POOL][i]->i;
+      append(&bytes, size, &capacity, &n, sizeof(n));
+    }
+    uint32_t textOffset = 0;
+    for (uint32_t i = 0; i < numTexts; i++){
+      Value *atom = (i < header.numSymbols) ? writer.pools[SYMBOL_POOL][i] :
+        writer.pools[STRING_POOL][i - header.numSymbols];
+      append(&bytes, size, &capacity, &textOffset, sizeof(textOffset));
+      textOffset += textLength(atom) + 1;
+    }
+    for (uint32_t i = 0; i < header.numStrings; i++){
+      uint32_t length = writer.pools[STRING_POOL][i]->length;
+      append(&bytes, size, &capacity, &length, sizeof(length));
+    }
+    for (uint32_t i = 0; i < header.numCells; i++){
+      uint32_t cell[2] = {numberOf(&writer, car(writer.pools[CELL_POOL][i])),
+                          numberOf(&writer, cdr(writer.pools[CELL_POOL][i]))};
+      append(&bytes, size, &capacity, cell, sizeof(cell));
+    }
+    for (uint32_t i = 0; i < numTexts; i++){
+      Value *atom = (i < header.numSymbols) ? writer.pools[SYMBOL_POOL][i] :
+        writer.pools[STRING_POOL][i - header.numSymbols];
+      append(&bytes, size, &capacity, atom->s, textLength(atom));
+      append(&bytes, size, &capacity, "", 1);
+    }
+    header.payloadHash = hashSource(bytes + sizeof(header), *size - sizeof(header));
+    memcpy(bytes, &header, sizeof(header));
+  }
+  for (int pool = 0; pool < NUM_POOLS; pool++){
+    free(writer.pools[pool]);
+  }
+  pointerTableFree(&writer.found);
+  return bytes;
+}
+
+
+// Returns the tree encoded in the size bytes at bytes, built in one
+// talloc'd array with its symbols and strings pointing into bytes (which
+// must outlive the tree), or NULL if bytes is not a well-formed encoding.
+static Value *decodeTree(const char *bytes, size_t size){
+  CacheHeader header;
+  if (size < sizeof(header)){
+    return NULL;
+  }
+  memcpy(&header, bytes, sizeof(header));
+  if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      (uint64_t)size != sizeof(header) + (uint64_t)header.numDoubles * sizeof(double) +
+        ((uint64_t)header.numInts + header.numSymbols + 2 * (uint64_t)header.numStrings +
+         2 * (uint64_t)header.numCells) * sizeof(uint32_t) + header.textSize ||
+      (header.textSize != 0 && bytes[size - 1] != '\0') ||
+      hashSource(bytes + sizeof(header), size - sizeof(header)) != header.payloadHash){
+    return NULL;
+  }
+  const double *doubles = (const double *)(bytes + sizeof(header));
+  const int32_t *ints = (const int32_t *)(doubles + header.numDoubles);
+  const uint32_t *texts = (const uint32_t *)(ints + header.numInts);
+  const uint32_t *lengths = texts + header.numSymbols + header.numStrings;
+  const uint32_t *cells = lengths + header.numStrings;
+  const char *text = (const char *)(cells + 2 * header.numCells);
+
+  // the Values are numbered in the order they are stored in values
+  uint64_t numValues = (uint64_t)header.numDoubles + header.numInts + header.numSymbols +
+    header.numStrings + 2 + header.numCells;
+  if (header.root >= numValues && header.root != NO_VALUE){
+    return NULL;
+  }
+  Value *values = talloc(numValues * sizeof(Value));
+  Value *next = values;
+  for (uint32_t i = 0; i < header.numDoubles; i++, next++){
+    next->type = DOUBLE_TYPE;
+    next->d = doubles[i];
+  }
+  for (uint32_t i = 0; i < header.numInts; i++, next++){
+    next->type = INT_TYPE;
+    next->i = ints[i];
+  }
+  for (uint32_t i = 0; i < header.numSymbols + header.numStrings; i++, next++){
+    if (texts[i] >= header.textSize){
+      return NULL;
+    }
+    next->type = (i < header.numSymbols) ? SYMBOL_TYPE : STR_TYPE;
+    next->s = (char *)text + texts[i];
+    if (next->type == STR_TYPE){
+      uint32_t length = lengths[i - header.numSymbols];
+      if (length >= header.textSize - texts[i] || next->s[length] != '\0'){
+        return NULL;
+      }
+      next->length = length;
+      next->chars = countChars(next->s, next->length);
+      next->inBuffer = 0;
+    }
+  }
+  for (int b = 0; b < 2; b++, next++){
+    next->type = BOOL_TYPE;
+    next->i = b;
+  }
+  for (uint32_t i = 0; i < 2 * header.numCells; i += 2, next++){
+    // (only Values numbered before the cell, so there is no cycle)
+    uint32_t number = next - values;
+    if ((cells[i] >= number && cells[i] != NO_VALUE) ||
+        (cells[i + 1] >= number && cells[i + 1] != NO_VALUE)){
+      return NULL;
+    }
+    next->type = CONS_TYPE;
+    next->c.car = (cells[i] == NO_VALUE) ? makeNull() : values + cells[i];
+    next->c.cdr = (cells[i + 1] == NO_VALUE) ? makeNull() : values + cells[i + 1];
+  }
+  if (header.root == NO_VALUE){
+    return makeNull();
+  }
+  return values + header.root;
+}
+
+
+// saves tree as the cache of the source with the given hash and length,
+// giving up quietly if it can't be encoded or written
+static void saveCache(Value *tree, uint64_t hash, size_t length, const char *cachePath){
+  size_t size;
+  char *bytes = encodeTree(tree, hash, length, &size);
+  if (bytes == NULL){
+    return;
+  }
+  // the file is written under a temporary name and renamed when complete,
+  // so a run reading the cache at the same time never sees half of it
+  char *tempPath = malloc(strlen(cachePath) + 32);
+  assert(tempPath != NULL && "Error (parsecache): out of memory");
+  sprintf(tempPath, "%s.%ld.tmp", cachePath, (long)getpid());
+  FILE *file = fopen(tempPath, "wb");
+  if (file != NULL){
+    int failed = fwrite(bytes, 1, size, file) != size;
+    failed = (fclose(file) != 0) || failed;
+    if (failed || rename(tempPath, cachePath) != 0){
+      unlink(tempPath);
+    }
+  }
+  free(tempPath);
+  free(bytes);
+}
+
+
+// A cache file loadCache() has mapped, which stays mapped as long as the
+// tree read from it may be in use, that is, until the process exits
+struct Mapping {
+  char *start;
+  size_t size;
+  struct Mapping *next;
+};
+
+typedef struct Mapping Mapping;
+
+// An entry of the module cache: the encoded tree of the file at path (an
+// absolute path), as it was when it had the given modification time and
+// size. The trees decoded from an entry point into its bytes, so entries
+// are only freed when the process exits; when a file changes, a new entry
+// goes in front of the old one.
+struct Module {
+  char *path;
+  struct timespec modified;
+  off_t size;
+  char *bytes;
+  size_t numBytes;
+  struct Module *next;
+};
+
+typedef struct Module Module;
+
+// the mapped cache files and the module cache, shared by every thread and
+// interpreter context
+static Mapping *mappings = NULL;
+static Module *modules = NULL;
+static pthread_mutex_t cachesLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t releaseOnce = PTHREAD_ONCE_INIT;
+
+
+// unmaps the cache files and frees the module cache, at exit
+static void releaseCaches(){
+  while (mappings != NULL){
+    Mapping *next = mappings->next;
+    munmap(mappings->start, mappings->size);
+    free(mappings);
+    mappings = next;
+  }
+  while (modules != NULL){
+    Module *next = modules->next;
+    free(modules->path);
+    free(modules->bytes);
+    free(modules);
+    modules = next;
+  }
+}
+
+
+// makes releaseCaches() run at exit
+static void registerReleaseCaches(){
+  atexit(releaseCaches);
+}
+
+
+// returns the tree saved in the cache at cachePath, or NULL if there is no
+// cache there for the source with the given hash and length
+static Value *loadCache(uint64_t hash, size_t length, const char *cachePath){
+  int fd = open(cachePath, O_RDONLY);
+  if (fd < 0){
+    return NULL;
+  }
+  struct stat status;
+  CacheHeader header;
+  if (fstat(fd, &status) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      header.sourceHash != hash || header.sourceLength != length){
+    close(fd);
+    return NULL;
+  }
+  char *file = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED){
+    return NULL;
+  }
+  Value *tree = decodeTree(file, status.st_size);
+  if (tree == NULL){
+    munmap(file, status.st_size);
+    return NULL;
+  }
+  // otherwise the file stays mapped, since the symbols and strings
+  // point into it
+  Mapping *mapping = malloc(sizeof(Mapping));
+  assert(mapping != NULL && "Error (parseCached): out of memory");
+  mapping->start = file;
+  mapping->size = status.st_size;
+  pthread_once(&releaseOnce, registerReleaseCaches);
+  pthread_mutex_lock(&cachesLock);
+  mapping->next = mappings;
+  mappings = mapping;
+  pthread_mutex_unlock(&cachesLock);
+  return tree;
+}
+
+
+// returns the parse tree of the length bytes at source (a malloc'd buffer
+// of the caller's, which a syntax error frees before it exits or jumps to
+// exitTrap, see talloc.h)
+static Value *parseSource(char *source, size_t length){
+  jmp_buf *outerTrap = exitTrap;
+  jmp_buf trap;
+  exitTrap = &trap;
+  int status = setjmp(trap);
+  if (status != 0){
+    exitTrap = outerTrap;
+    free(source);
+    texit(status);
+  }
+  Value *tree = parse(tokenizeBuffer(source, length));
+  exitTrap = outerTrap;
+  return tree;
+}
+
+
+// returns the contents of the file at path (*length bytes) in a malloc'd
+// buffer, or NULL if it can't be read; stores its status in *status
+static char *readFile(const char *path, size_t *length, struct stat *status){
+  FILE *file = fopen(path, "rb");
+  if (file == NULL){
+    return NULL;
+  }
+  if (fstat(fileno(file), status) != 0){
+    fclose(file);
+    return NULL;
+  }
+  size_t capacity = 64 * 1024;
+  char *contents = malloc(capacity);
+  assert(contents != NULL && "Error (parsecache): out of memory");
+  *length = 0;
+  size_t count;
+  while ((count = fread(contents + *length, 1, capacity - *length, file)) > 0){
+    *length += count;
+    if (*length == capacity){
+      capacity *= 2;
+      contents = realloc(contents, capacity);
+      assert(contents != NULL && "Error (parsecache): out of memory");
+    }
+  }
+  if (ferror(file)){
+    free(contents);
+    contents = NULL;
+  }
+  fclose(file);
+  return contents;
+}
+
+
+// Returns the parse tree of the program in the file at path, through the
+// cache at cachePath.
+Value *parseCached(const char *path, const char *cachePath){
+  size_t length;
+  struct stat status;
+  char *source = readFile(path, &length, &status);
+  if (source == NULL){
+    return NULL;
+  }
+  uint64_t hash = hashSource(source, length);
+  Value *tree = loadCache(hash, length, cachePath);
+  if (tree == NULL){
+    tree = parseSource(source, length);
+    saveCache(tree, hash, length, cachePath);
+  }
+  free(source);
+  return tree;
+}
+
+
+// returns the newest entry of the module cache for path, or NULL
+static Module *findModule(const char *path){
+  pthread_mutex_lock(&cachesLock);
+  Module *module = modules;
+  while (module != NULL && strcmp(module->path, path) != 0){
+    module = module->next;
+  }
+  pthread_mutex_unlock(&cachesLock);
+  return module;
+}
+
+
+// Returns the parse tree of the program in the file at path, through the
+// module cache.
+Value *parseModule(const char *path){
+  char fullPath[PATH_MAX];
+  struct stat status;
+  if (realpath(path, fullPath) == NULL || stat(fullPath, &status) != 0){
+    return NULL;
+  }
+  Module *module = findModule(fullPath);
+  if (module != NULL && module->size == status.st_size &&
+      module->modified.tv_sec == status.st_mtim.tv_sec &&
+      module->modified.tv_nsec == status.st_mtim.tv_nsec){
+    Value *tree = decodeTree(module->bytes, module->numBytes);
+    assert(tree != NULL && "Error (parseModule): bad module cache entry");
+    return tree;
+  }
+
+  size_t length;
+  char *source = readFile(fullPath, &length, &status);
+  if (source == NULL){
+    return NULL;
+  }
+  Value *tree = parseSource(source, length);
+  size_t numBytes;
+  char *bytes = encodeTree(tree, hashSource(source, length), length, &numBytes);
+  free(source);
+  if (bytes != NULL){
+    module = malloc(sizeof(Module));
+    assert(module != NULL && "Error (parseModule): out of memory");
+    module->path = strdup(fullPath);
+    module->modified = status.st_mtim;
+    module->size = status.st_size;
+    module->bytes = bytes;
+    module->numBytes = numBytes;
+    pthread_once(&releaseOnce, registerReleaseCaches);
+    pthread_mutex_lock(&cachesLock);
+    module->next = modules;
+    modules = module;
+    pthread_mutex_unlock(&cachesLock);
+  }
+  return tree;
+}
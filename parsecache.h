@@ -0,0 +1,33 @@
+#include <stddef.h>
+#include "value.h"
+
+#ifndef _PARSECACHE
+#define _PARSECACHE
+
+// A parse cache file holds the parse tree of one program in a compact binary
+// form, so that running an unchanged program again skips tokenize() and
+// parse(). Every distinct atom is stored once, in a pool for its type
+// (integers, doubles, symbols, strings, with the text of the last two in one
+// block), and every cons cell as the indices of its car and cdr. Loading
+// maps the file and builds all the Values of the tree in one talloc'd
+// array, with the symbols and strings pointing into the mapping.
+
+// Returns the parse tree of the program in the file at path, or NULL if the
+// file can't be read. If the file at cachePath holds the tree of the same
+// source (same length and hash), it is loaded from there; otherwise the
+// program is tokenized and parsed, and the tree is saved at cachePath for
+// the next run. The cache is only an optimization: when it can't be read or
+// written, the program is parsed as usual.
+Value *parseCached(const char *path, const char *cachePath);
+
+// Returns the parse tree of the program in the file at path, or NULL if the
+// file can't be read, like parseCached() but through an in-process module
+// cache instead of a file: the first call for a file parses it and keeps
+// the tree in the same compact form, keyed by the file's absolute path,
+// modification time and size, and later calls build the tree from there.
+// The tree is talloc'd from the calling thread's heap. The module cache, like
+// the mappings of the cache files read by parseCached(), is freed when the
+// process exits.
+Value *parseModule(const char *path);
+
+#endif
@@ -2,25 +2,97 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include "parser.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "talloc.h"
+#include "intern.h"
+#include "output.h"
 
 
-// Prints an error message for the two types of parsing
-// errors (too many/few closing parentheses) and exit the program
-void syntaxError(int type){
-  if (type == 0){
-    printf("Syntax error: too many close parentheses\n");
+// the stream output goes to on this thread (NULL means stdout)
+_Thread_local FILE *output = NULL;
+
+
+// Returns the stream that output goes to on the calling thread.
+FILE *outputStream(){
+  if (output == NULL){
+    return stdout;
   }
-  else{
-    printf("Syntax error: not enough close parentheses\n");
+  return output;
+}
+
+
+// Makes output on the calling thread go to stream, after writing what
+// was buffered for the old stream to it.
+void setOutputStream(FILE *stream){
+  outputFlush();
+  output = stream;
+}
+
+
+// non-zero while syntax errors are not printed on this thread
+static _Thread_local int quietSyntaxErrors = 0;
+
+
+// Makes syntax errors on the calling thread go unprinted (if quiet is
+// non-zero), and returns the setting before.
+int setQuietSyntaxErrors(int quiet){
+  int oldQuiet = quietSyntaxErrors;
+  quietSyntaxErrors = quiet;
+  return oldQuiet;
+}
+
+
+// Prints the message of a syntax error (a printf format and its arguments),
+// unless syntax errors are quiet, and exits.
+void reportSyntaxError(const char *format, ...){
+  if (!quietSyntaxErrors){
+    outputFlush();
+    va_list args;
+    va_start(args, format);
+    vfprintf(outputStream(), format, args);
+    va_end(args);
   }
   texit(1);
 }
 
 
+// the kinds of syntax errors
+#define TOO_MANY_CLOSE 0
+#define NOT_ENOUGH_CLOSE 1
+#define MISMATCHED_CLOSE 2
+#define MISPLACED_DOT 3
+#define QUOTE_WITHOUT_DATUM 4
+#define DOTTED_CODE 5
+
+// Prints an error message for a type of parsing error
+// (e.g. too many/few closing parentheses) and exit the program
+void syntaxError(int type){
+  switch (type){
+    case TOO_MANY_CLOSE:
+      reportSyntaxError("Syntax error: too many close parentheses\n");
+      break;
+    case NOT_ENOUGH_CLOSE:
+      reportSyntaxError("Syntax error: not enough close parentheses\n");
+      break;
+    case MISMATCHED_CLOSE:
+      reportSyntaxError("Syntax error: a list opened with ( must close with ) and one opened with [ with ]\n");
+      break;
+    case MISPLACED_DOT:
+      reportSyntaxError("Syntax error: a dot must come before the last item of a list of two or more\n");
+      break;
+    case QUOTE_WITHOUT_DATUM:
+      reportSyntaxError("Syntax error: quote mark not followed by a datum\n");
+      break;
+    default:
+      reportSyntaxError("Syntax error: a dotted list can only be quoted data, not code\n");
+      break;
+  }
+}
+
+
 // push a Value onto a stack (managed as a linked list)
 // returns pointer to the stack after pushing the Value
 // Note: this method assumes that stack is a linked list // (i.e. always ends with a NULL_TYPE Value)
@@ -47,60 +119,171 @@ Value *pop(Value **stackPointer){
   }
   else{
     // the first item on the list should be the one that pops out first because it is added last
-    poppedVal = car(*stackPointer);
+    Value *top = *stackPointer;
+    poppedVal = car(top);
     // modify the stack
-    *stackPointer = cdr(*stackPointer);
+    *stackPointer = cdr(top);
+    // the popped cell was only part of the stack,
+    // so it can be reused for the next push
+    trelease(top, sizeof(Value));
   }
   return poppedVal;
 }
 
 
+// The state of parse(): the number of lists opened and not yet closed,
+// and for each of them (in dotted[1] to dotted[depth]) whether it holds a
+// dotted list outside quoted data so far. eval can't run such a list, so
+// a top-level form with one is a syntax error.
+struct ParseState {
+  int depth;
+  char *dotted;
+  int capacity;
+};
+
+typedef struct ParseState ParseState;
+
+
+// returns the tail of a dotted list that ends with . item: the list
+// item stands for, or item itself if it isn't one
+static Value *dottedTail(Value *item){
+  // (the empty list is a cell with a NULL_TYPE car, see popSubtree())
+  if (item->type == CONS_TYPE && car(item)->type == NULL_TYPE){
+    return makeNull();
+  }
+  return item;
+}
+
+
 // pop items of the stack until we popped off an open
-// parenthesis, adding each item to the head of a 
-// new linked list which represents the subtree
-// and return this new linked list
-Value *popSubtree(Value **stack){
+// parenthesis or bracket (matching closeType), adding each
+// item to the head of a new linked list which represents
+// the subtree and return this new linked list
+// a dot before the last item makes that item the tail of the
+// list instead, and sets *isDotted
+// note: the subtree is built from the literal pool, so
+// identical subtrees (e.g. repeated quoted lists) share cells
+Value *popSubtree(Value **stack, valueType closeType, int *isDotted){
   Value *subtree = makeNull();
+  // the item popped last, only added to subtree once the next
+  // pop shows that it isn't after a dot
+  Value *last = NULL;
+  *isDotted = 0;
   // note that pop() changes the stack variable's
   // value in popSubtree()
   Value *curVal = pop(stack);
-  while (curVal->type != OPEN_TYPE){
+  while (curVal->type != OPEN_TYPE && curVal->type != OPENBRACKET_TYPE){
     // if reach bottom of stack, raise error
     // because there are too many closing parentheses
     if (curVal->type == NULL_TYPE){
-      syntaxError(0);
+      syntaxError(TOO_MANY_CLOSE);
+    }
+    if (curVal->type == SINGLEQUOTE_TYPE){
+      syntaxError(QUOTE_WITHOUT_DATUM);
+    }
+    if (curVal->type == DOT_TYPE){
+      // exactly one item can follow the dot
+      if (last == NULL || subtree->type != NULL_TYPE || *isDotted){
+        syntaxError(MISPLACED_DOT);
+      }
+      subtree = dottedTail(last);
+      last = NULL;
+      *isDotted = 1;
+    }
+    else{
+      if (last != NULL){
+        subtree = internCons(last, subtree);
+      }
+      last = curVal;
     }
-    subtree = cons(curVal, subtree);
     curVal = pop(stack);
   }
+  if ((curVal->type == OPEN_TYPE) != (closeType == CLOSE_TYPE)){
+    syntaxError(MISMATCHED_CLOSE);
+  }
+  if (last != NULL){
+    subtree = internCons(last, subtree);
+  }
+  else if (*isDotted){
+    // nothing before the dot
+    syntaxError(MISPLACED_DOT);
+  }
   // this is to account for the empty subtree
   // i.e. an empty s-expression ()
   if (subtree->type == NULL_TYPE){
-    subtree = cons(makeNull(), subtree);
+    subtree = internCons(subtree, subtree);
   }
   return subtree;
 }
 
 
+// returns non-zero if subtree is a list starting with the symbol quote
+static int isQuoteForm(Value *subtree){
+  return subtree->type == CONS_TYPE && car(subtree)->type == SYMBOL_TYPE &&
+         strcmp(car(subtree)->s, "quote") == 0;
+}
+
+
+// pushes a datum onto the stack, first making it (quote datum) for each
+// quote mark right before it ('datum); dotted is whether it holds a
+// dotted list outside quoted data, which is recorded for the list it is in
+Value *pushDatum(Value *tree, ParseState *state, Value *datum, int dotted){
+  while (tree->type != NULL_TYPE && car(tree)->type == SINGLEQUOTE_TYPE){
+    pop(&tree);
+    // (the literal pool has one quote symbol and shares the cells)
+    Value quote;
+    quote.type = SYMBOL_TYPE;
+    quote.s = "quote";
+    datum = internCons(internAtom(&quote), internCons(datum, makeNull()));
+    dotted = 0;
+  }
+  if (dotted){
+    if (state->depth == 0){
+      syntaxError(DOTTED_CODE);
+    }
+    state->dotted[state->depth] = 1;
+  }
+  return push(tree, datum);
+}
+
+
 // Add the current token to the current tree
-// (the tree and the stack is maintained together in 
+// (the tree and the stack is maintained together in
 // the same linked list)
-// depth is updated to represent the number of unclosed open parentheses in the parse tree
-Value *addToParseTree(Value *tree, int *depth, Value *token){
-  // push onto stack if token is not a close parenthesis
-  if (token->type != CLOSE_TYPE){
+// state->depth is updated to represent the number of unclosed open parentheses in the parse tree
+Value *addToParseTree(Value *tree, ParseState *state, Value *token){
+  if (token->type == OPEN_TYPE || token->type == OPENBRACKET_TYPE){
     tree = push(tree, token);
-    if (token->type == OPEN_TYPE){
-      (*depth)++;
+    state->depth++;
+    if (state->depth == state->capacity){
+      int capacity = 2 * state->capacity;
+      char *dotted = talloc(capacity);
+      memcpy(dotted, state->dotted, state->capacity);
+      trelease(state->dotted, state->capacity);
+      state->dotted = dotted;
+      state->capacity = capacity;
     }
+    state->dotted[state->depth] = 0;
   }
-  else{
+  else if (token->type == CLOSE_TYPE || token->type == CLOSEBRACKET_TYPE){
     // note: we don't need to push the CLOSE_TYPE Value onto the stack
-    Value *subtree = popSubtree(&tree);
-    // push subtree back onto the stack
-    tree = push(tree, subtree);
+    int isDotted;
+    Value *subtree = popSubtree(&tree, token->type, &isDotted);
+    int dotted = (isDotted || state->dotted[state->depth]) && !isQuoteForm(subtree);
     // decrease depth by 1
-    (*depth)--;
+    state->depth--;
+    // push subtree back onto the stack
+    tree = pushDatum(tree, state, subtree, dotted);
+  }
+  else if (token->type == SINGLEQUOTE_TYPE || token->type == DOT_TYPE){
+    // the datum after a quote mark or dot is yet to come
+    if (token->type == DOT_TYPE && state->depth == 0){
+      syntaxError(MISPLACED_DOT);
+    }
+    tree = push(tree, token);
+  }
+  else{
+    tree = pushDatum(tree, state, token, 0);
   }
   // return current tree
   return tree;
@@ -111,49 +294,64 @@ Value *addToParseTree(Value *tree, int *depth, Value *token){
 // parse tree representing that program.
 Value *parse(Value *tokens){
   Value *tree = makeNull();
-  int depth = 0;
+  ParseState state;
+  state.depth = 0;
+  state.capacity = 64;
+  state.dotted = talloc(state.capacity);
 
   Value *current = tokens;
   assert(current != NULL && "Error (parse): null pointer");
   while (current->type != NULL_TYPE) {
     Value *token = car(current);
-    tree = addToParseTree(tree, &depth, token);
+    tree = addToParseTree(tree, &state, token);
     current = cdr(current);
   }
-  if (depth != 0) {
+  if (state.depth != 0) {
     // if depth is not 0, then there is open parenthesis
     // remaining in the stack, thus raise error
-    syntaxError(1);
+    syntaxError(NOT_ENOUGH_CLOSE);
+  }
+  if (tree->type != NULL_TYPE && car(tree)->type == SINGLEQUOTE_TYPE){
+    syntaxError(QUOTE_WITHOUT_DATUM);
   }
+  trelease(state.dotted, state.capacity);
   // note: tokens are added to the tree in reverse order 
   return reverse(tree);
 }
 
 
-void printAtom(Value *tree){
+// writes an atom to the output buffer the way printTree() shows it
+// (strings in double quotes and every atom followed by a space) or,
+// if forDisplay is non-zero, the way display shows it
+void printAtom(Value *tree, int forDisplay){
   switch (tree->type){
     case BOOL_TYPE:
-      if (tree->i){
-        printf("#t ");
+      outputString(tree->i ? "#t" : "#f");
+      break;
+    case STR_TYPE:
+      if (forDisplay){
+        outputBytes(tree->s, tree->length);
       }
       else{
-        printf("#f ");
+        outputChar('"');
+        outputBytes(tree->s, tree->length);
+        outputChar('"');
       }
       break;
-    case STR_TYPE:
-      printf("\"%s\" ", tree->s);
-      break;
     case INT_TYPE:
-      printf("%i ", tree->i);
+      outputInt(tree->i);
       break;
     case DOUBLE_TYPE:
-      printf("%f ", tree->d);  
-      break; 
+      outputDouble(tree->d);
+      break;
     case SYMBOL_TYPE:
-      printf("%s ", tree->s); 
+      outputString(tree->s);
       break;
     case CLOSURE_TYPE:
-      printf("#<procedure> ");
+      outputString("#<procedure>");
+      break;
+    case FUTURE_TYPE:
+      outputString("#<future>");
       break;
     case CONS_TYPE:
     case NULL_TYPE:
@@ -166,9 +364,12 @@ void printAtom(Value *tree){
     case CLOSE_TYPE:
     case VOID_TYPE:
     case PRIMITIVE_TYPE:
-      break;    
+      return;
+  }
+  if (!forDisplay){
+    outputChar(' ');
   }
-} 
+}
 
 
 // Prints the tree to the screen in a readable fashion. It should look just like
@@ -176,28 +377,105 @@ void printAtom(Value *tree){
 // Note: tree passed in should always be either
 // CONS_TYPE or NULL_TYPE
 void printTree(Value *tree){
-  if (tree->type == NULL_TYPE){
-    return;
-  }
   if (tree->type != CONS_TYPE){
-    printAtom(tree);
+    printAtom(tree, 0);
     return;
   }
-  else{
-    if ((car(tree))->type == CONS_TYPE){
-      printf("( ");
-      printTree(car(tree));
-      printf(") ");
+  ListWalk walk;
+  listWalkStart(&walk, tree);
+  Value *value;
+  ListEvent event;
+  while ((event = listWalkNext(&walk, &value)) != LIST_END){
+    switch (event){
+      case LIST_ITEM:
+        printAtom(value, 0);
+        break;
+      case LIST_OPEN:
+        outputString("( ");
+        break;
+      case LIST_CLOSE:
+        outputString(") ");
+        break;
+      case LIST_TAIL:
+        outputString(". ");
+        printAtom(value, 0);
+        break;
+      case LIST_CYCLE:
+        outputString("... ");
+        break;
+      case LIST_END:
+        break;
     }
-    else{
-      printTree(car(tree));
-    }
-    if ((cdr(tree))->type != NULL_TYPE){
-      if ((cdr(tree))->type != CONS_TYPE){
-        printf(". ");
-      }
+  }
+  listWalkEnd(&walk);
+}
+
+
+// writes the items of list (which is not wrapped, see displayValue())
+// in parentheses, separated by spaces
+void displayList(Value *list){
+  outputChar('(');
+  // whether the next item needs a space before it
+  int separate = 0;
+  ListWalk walk;
+  listWalkStart(&walk, list);
+  Value *value;
+  ListEvent event;
+  while ((event = listWalkNext(&walk, &value)) != LIST_END){
+    switch (event){
+      case LIST_ITEM:
+        if (value->type == NULL_TYPE){
+          break;
+        }
+        if (separate){
+          outputChar(' ');
+        }
+        printAtom(value, 1);
+        separate = 1;
+        break;
+      case LIST_OPEN:
+        if (separate){
+          outputChar(' ');
+        }
+        outputChar('(');
+        separate = 0;
+        break;
+      case LIST_CLOSE:
+        outputChar(')');
+        separate = 1;
+        break;
+      case LIST_TAIL:
+        outputString(" . ");
+        printAtom(value, 1);
+        break;
+      case LIST_CYCLE:
+        if (separate){
+          outputChar(' ');
+        }
+        outputString("...");
+        separate = 1;
+        break;
+      case LIST_END:
+        break;
     }
-    printTree(cdr(tree));
   }
-  return;
-}
\ No newline at end of file
+  listWalkEnd(&walk);
+  outputChar(')');
+}
+
+
+// Prints value, a result of eval(), the way Scheme's display does:
+// lists as (a b c), and strings without quotes.
+void displayValue(Value *value){
+  // results that are lists (and the results of car) come wrapped
+  // in a one-item list, for printTree()
+  if (value->type == CONS_TYPE){
+    value = car(value);
+  }
+  if (value->type == CONS_TYPE){
+    displayList(value);
+  }
+  else{
+    printAtom(value, 1);
+  }
+}
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "value.h"
 
 #ifndef _PARSER
@@ -12,5 +13,25 @@ Value *parse(Value *tokens);
 // Racket code; use parentheses to indicate subtrees.
 void printTree(Value *tree);
 
+// Prints value, a result of eval(), the way Scheme's display does.
+// Like printTree(), it writes to the output buffer (see output.h).
+void displayValue(Value *value);
+
+// Returns the stream that printTree() and error messages write to on the
+// calling thread: stdout, unless an interpreter context (see interp.h) has
+// set another one with setOutputStream().
+FILE *outputStream();
+void setOutputStream(FILE *stream);
+
+// Prints the message of a syntax error (a printf format and its arguments)
+// to outputStream() and calls texit(), as the tokenizer and parser do on a
+// syntax error.
+void reportSyntaxError(const char *format, ...);
+
+// Makes the syntax errors on the calling thread exit without printing a
+// message (if quiet is non-zero), for callers that trap the exit and report
+// the error their own way, and returns the setting before.
+int setQuietSyntaxErrors(int quiet);
+
 
 #endif
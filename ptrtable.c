@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "ptrtable.h"
+
+
+// returns the slot of table for address: its own or an empty one
+static size_t findSlot(PointerTable *table, uintptr_t address){
+  size_t mask = table->capacity - 1;
+  size_t slot = (size_t)((address >> 3) * 0x9E3779B97F4A7C15ULL) & mask;
+  while (table->keys[slot] != 0 && table->keys[slot] != address){
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+
+// doubles the capacity of table, which is kept at most half full
+static void grow(PointerTable *table){
+  uintptr_t *oldKeys = table->keys;
+  uint64_t *oldNumbers = table->numbers;
+  size_t oldCapacity = table->capacity;
+  table->capacity = (oldCapacity == 0) ? 1024 : oldCapacity * 2;
+  table->keys = calloc(table->capacity, sizeof(uintptr_t));
+  table->numbers = malloc(table->capacity * sizeof(uint64_t));
+  assert(table->keys != NULL && table->numbers != NULL && "Error (ptrtable): out of memory");
+  for (size_t i = 0; i < oldCapacity; i++){
+    if (oldKeys[i] != 0){
+      size_t slot = findSlot(table, oldKeys[i]);
+      table->keys[slot] = oldKeys[i];
+      table->numbers[slot] = oldNumbers[i];
+    }
+  }
+  free(oldKeys);
+  free(oldNumbers);
+}
+
+
+// Makes table empty.
+void pointerTableInit(PointerTable *table){
+  table->keys = NULL;
+  table->numbers = NULL;
+  table->count = 0;
+  table->capacity = 0;
+}
+
+
+// Looks up the number of address in table.
+int pointerTableGet(PointerTable *table, const void *address, uint64_t *number){
+  if (table->count == 0){
+    return 0;
+  }
+  size_t slot = findSlot(table, (uintptr_t)address);
+  if (table->keys[slot] == 0){
+    return 0;
+  }
+  *number = table->numbers[slot];
+  return 1;
+}
+
+
+// Adds address to table with number.
+void pointerTablePut(PointerTable *table, const void *address, uint64_t number){
+  if (2 * (table->count + 1) > table->capacity){
+    grow(table);
+  }
+  size_t slot = findSlot(table, (uintptr_t)address);
+  table->keys[slot] = (uintptr_t)address;
+  table->numbers[slot] = number;
+  table->count++;
+}
+
+
+// Frees the memory of table.
+void pointerTableFree(PointerTable *table){
+  free(table->keys);
+  free(table->numbers);
+  pointerTableInit(table);
+}
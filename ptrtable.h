@@ -0,0 +1,33 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef _PTRTABLE
+#define _PTRTABLE
+
+// A hash table from addresses to numbers, used to give every object of a
+// graph being written to a file (see image.h and parsecache.h) one number,
+// however many times the graph refers to it. It uses malloc, not talloc,
+// so it can't be collected while it is in use.
+struct PointerTable {
+  uintptr_t *keys;
+  uint64_t *numbers;
+  size_t count;
+  size_t capacity;
+};
+
+typedef struct PointerTable PointerTable;
+
+// Makes table empty. Call pointerTableFree() when done with it.
+void pointerTableInit(PointerTable *table);
+
+// If address is in table, stores its number in *number and returns 1;
+// otherwise returns 0.
+int pointerTableGet(PointerTable *table, const void *address, uint64_t *number);
+
+// Adds address, which must not be NULL or in table yet, with number.
+void pointerTablePut(PointerTable *table, const void *address, uint64_t number);
+
+// Frees the memory of table.
+void pointerTableFree(PointerTable *table);
+
+#endif
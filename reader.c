@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "value.h"
+#include "talloc.h"
+#include "linkedlist.h"
+#include "tokenizer.h"
+#include "parser.h"
+#include "intern.h"
+#include "parallel.h"
+#include "reader.h"
+
+// files smaller than this are read by one thread
+#define PARALLEL_READ_MIN_SIZE (1024 * 1024)
+
+// the smallest chunk, and the number of chunks per thread (more than one,
+// so that threads that finish early can take the chunks of the others)
+#define MIN_CHUNK_SIZE (256 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+// The tokenizing and parsing of one chunk of a program. forms is the list
+// of its top-level forms, or failed is set if it has an error.
+struct ChunkTask {
+  Task task;
+  const char *start;
+  size_t length;
+  Heap *heap;
+  InternPool *pool;
+  Value *forms;
+  int failed;
+};
+
+typedef struct ChunkTask ChunkTask;
+
+
+// Splits the length bytes at text into at most maxChunks chunks of about
+// chunkSize bytes that end after top-level forms, storing where each one
+// starts in starts. Returns the number of chunks, or -1 if the parentheses
+// and brackets don't balance or a string is not ended (so that the program
+// is read in one piece and the error reported).
+static int findChunks(const char *text, size_t length, size_t chunkSize,
+                      const char **starts, int maxChunks){
+  const char *end = text + length;
+  const char *chunkStart = text;
+  int count = 1;
+  starts[0] = text;
+  long depth = 0;
+  const char *p = scanFor(text, end, "()[]\";", 6);
+  while (p != end){
+    if (*p == '(' || *p == '['){
+      depth++;
+    }
+    else if (*p == ')' || *p == ']'){
+      depth--;
+      if (depth < 0){
+        return -1;
+      }
+      if (depth == 0 && (size_t)(p + 1 - chunkStart) >= chunkSize && count < maxChunks){
+        chunkStart = p + 1;
+        starts[count] = chunkStart;
+        count++;
+      }
+    }
+    else if (*p == '"'){
+      // (strings have no escapes, see readString())
+      p = scanFor(p + 1, end, "\"", 1);
+      if (p == end){
+        return -1;
+      }
+    }
+    else{
+      p = scanFor(p + 1, end, "\n", 1);
+      if (p == end){
+        break;
+      }
+    }
+    p = scanFor(p + 1, end, "()[]\";", 6);
+  }
+  return (depth == 0) ? count : -1;
+}
+
+
+// tokenizes and parses a chunk on the thread that runs the task, with the
+// heap and literal pool of the reading thread, and with syntax errors
+// unprinted
+static void runChunk(Task *task){
+  ChunkTask *chunk = task->data;
+  Heap *outerHeap = activeHeap();
+  InternPool *outerPool = activeInternPool();
+  int outerQuiet = setQuietSyntaxErrors(1);
+  jmp_buf *outerTrap = exitTrap;
+  setActiveHeap(chunk->heap);
+  setActiveInternPool(chunk->pool);
+
+  jmp_buf trap;
+  exitTrap = &trap;
+  if (setjmp(trap) == 0){
+    chunk->forms = parse(tokenizeBuffer(chunk->start, chunk->length));
+  }
+  else{
+    chunk->failed = 1;
+  }
+
+  exitTrap = outerTrap;
+  setQuietSyntaxErrors(outerQuiet);
+  setActiveInternPool(outerPool);
+  setActiveHeap(outerHeap);
+}
+
+
+// returns the parse tree of the length bytes at text, reading its chunks
+// in parallel, or NULL if it must be read in one piece
+static Value *readChunks(const char *text, size_t length){
+  if (memchr(text, 0xFF, length) != NULL){
+    // (where a 0xFF byte ends the program depends on what it is in)
+    return NULL;
+  }
+  int maxChunks = CHUNKS_PER_THREAD * parallelNumThreads();
+  size_t chunkSize = length / maxChunks;
+  if (chunkSize < MIN_CHUNK_SIZE){
+    chunkSize = MIN_CHUNK_SIZE;
+  }
+  const char **starts = malloc(maxChunks * sizeof(const char *));
+  assert(starts != NULL && "Error (readChunks): out of memory");
+  int numChunks = findChunks(text, length, chunkSize, starts, maxChunks);
+  if (numChunks <= 1){
+    free(starts);
+    return NULL;
+  }
+
+  ChunkTask *chunks = calloc(numChunks, sizeof(ChunkTask));
+  assert(chunks != NULL && "Error (readChunks): out of memory");
+  InternPool *pool = activeInternPool();
+  setInternPoolConcurrent(pool, 1);
+  for (int i = 0; i < numChunks; i++){
+    const char *chunkEnd = (i + 1 < numChunks) ? starts[i + 1] : text + length;
+    chunks[i].start = starts[i];
+    chunks[i].length = chunkEnd - starts[i];
+    chunks[i].heap = activeHeap();
+    chunks[i].pool = pool;
+    chunks[i].task.run = runChunk;
+    chunks[i].task.data = &chunks[i];
+    spawnTask(&chunks[i].task);
+  }
+  // (waiting for the last one spawned first runs the others here too)
+  int failed = 0;
+  for (int i = numChunks - 1; i >= 0; i--){
+    waitForTask(&chunks[i].task);
+    failed = failed || chunks[i].failed;
+  }
+  setInternPoolConcurrent(pool, 0);
+  free(starts);
+
+  // the forms of the chunks are joined, from the last one back
+  Value *tree = makeNull();
+  for (int i = numChunks - 1; i >= 0 && !failed; i--){
+    Value *forms = chunks[i].forms;
+    if (forms->type != NULL_TYPE){
+      Value *last = forms;
+      while (cdr(last)->type != NULL_TYPE){
+        last = cdr(last);
+      }
+      (last->c).cdr = tree;
+      tree = forms;
+    }
+  }
+  free(chunks);
+  return failed ? NULL : tree;
+}
+
+
+// Returns the parse tree of the program read from stream.
+Value *readProgram(FILE *stream){
+  struct stat status;
+  int fd = fileno(stream);
+  if (!parallelEnabled() || parallelNumThreads() < 2 || fd < 0 ||
+      fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)){
+    return parse(tokenizeFile(stream));
+  }
+  // (the rest of the file, from where the stream is)
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (offset < 0 || status.st_size - offset < PARALLEL_READ_MIN_SIZE){
+    return parse(tokenizeFile(stream));
+  }
+  size_t length = status.st_size - offset;
+  char *file = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (file == MAP_FAILED){
+    return parse(tokenizeFile(stream));
+  }
+  Value *tree = readChunks(file + offset, length);
+  if (tree == NULL){
+    tree = parse(tokenizeBuffer(file + offset, length));
+  }
+  // the tree has its own copies of the text of symbols and strings
+  munmap(file, status.st_size);
+  return tree;
+}
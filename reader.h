@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include "value.h"
+
+#ifndef _READER
+#define _READER
+
+// Returns the parse tree of the program read from stream, like
+// parse(tokenizeFile(stream)). When the thread pool is running (see
+// parallel.h) and stream is a large regular file, the file is mapped and
+// split into chunks at boundaries between top-level forms, found by one
+// quick pass over the parentheses outside strings and comments. The chunks
+// are tokenized and parsed by the threads of the pool at the same time,
+// adding to the same literal pool, and their forms joined in order. If
+// anything in a chunk is not valid, the whole program is read again in one
+// piece, so that the error is reported as it would be otherwise.
+Value *readProgram(FILE *stream);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "interp.h"
+#include "server.h"
+
+
+// A client connected to the socket
+struct Connection {
+  Interpreter *interp;
+  int fd;
+};
+
+typedef struct Connection Connection;
+
+
+// reads the next program (up to a NUL byte or the end of in) into a
+// malloc'd string; returns NULL if in has ended
+static char *readProgram(FILE *in){
+  size_t capacity = 4096;
+  size_t length = 0;
+  char *program = malloc(capacity);
+  assert(program != NULL && "Error (serve): out of memory");
+  int next = fgetc(in);
+  if (next == EOF){
+    free(program);
+    return NULL;
+  }
+  while (next != EOF && next != '\0'){
+    if (length + 1 == capacity){
+      capacity *= 2;
+      program = realloc(program, capacity);
+      assert(program != NULL && "Error (serve): out of memory");
+    }
+    program[length] = (char)next;
+    length++;
+    next = fgetc(in);
+  }
+  program[length] = '\0';
+  return program;
+}
+
+
+// Serves the programs read from in, writing their output to out.
+void serveStream(Interpreter *interp, FILE *in, FILE *out){
+  // results reach the client as soon as each line is printed
+  setvbuf(out, NULL, _IOLBF, 0);
+  char *program = readProgram(in);
+  while (program != NULL){
+    interpEvalIsolated(interp, program, out);
+    fputc('\0', out);
+    fflush(out);
+    free(program);
+    program = readProgram(in);
+  }
+}
+
+
+// the thread serving one connection
+static void *serveConnection(void *arg){
+  Connection *connection = arg;
+  FILE *in = fdopen(connection->fd, "r");
+  FILE *out = fdopen(dup(connection->fd), "w");
+  if (in != NULL && out != NULL){
+    serveStream(connection->interp, in, out);
+  }
+  if (in != NULL){
+    fclose(in);
+  }
+  if (out != NULL){
+    fclose(out);
+  }
+  free(connection);
+  return NULL;
+}
+
+
+// Listens on a Unix domain socket at path and serves each connection
+// on a thread of its own.
+int serveSocket(Interpreter *interp, const char *path){
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)){
+    fprintf(stderr, "serve: socket path too long: %s\n", path);
+    return 1;
+  }
+  strcpy(address.sun_path, path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0){
+    perror("serve");
+    return 1;
+  }
+  // a socket left by an earlier server is replaced, but nothing else is
+  struct stat status;
+  if (lstat(path, &status) == 0){
+    if (!S_ISSOCK(status.st_mode)){
+      fprintf(stderr, "serve: %s exists and is not a socket\n", path);
+      close(listener);
+      return 1;
+    }
+    unlink(path);
+  }
+  if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(listener, 64) < 0){
+    perror("serve");
+    close(listener);
+    return 1;
+  }
+  // a client that disconnects early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+  while (1){
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0){
+      if (errno == EINTR){
+        continue;
+      }
+      perror("serve");
+      close(listener);
+      return 1;
+    }
+    Connection *connection = malloc(sizeof(Connection));
+    assert(connection != NULL && "Error (serve): out of memory");
+    connection->interp = interp;
+    connection->fd = fd;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serveConnection, connection) != 0){
+      close(fd);
+      free(connection);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include "interp.h"
+
+#ifndef _SERVER
+#define _SERVER
+
+// Serve mode keeps one interpreter running for many programs, so each one
+// skips process startup and the setting up of the top-level frame. A client
+// sends programs one after another, each followed by a NUL byte; each runs
+// with interpEvalIsolated() in a fresh environment whose parent is the
+// top-level frame of interp, and its output is streamed back line by line,
+// followed by a NUL byte once the program has ended.
+
+// Serves the programs read from in, writing their output to out, until the
+// end of in.
+void serveStream(Interpreter *interp, FILE *in, FILE *out);
+
+// Listens on a Unix domain socket at path and serves each connection on a
+// thread of its own. A socket already at path (e.g. left by an earlier
+// server) is replaced, but any other file there is an error. Only returns
+// (with 1) if the socket cannot be set up.
+int serveSocket(Interpreter *interp, const char *path);
+
+#endif
@@ -0,0 +1,64 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "stack.h"
+
+// the room kept below stackLimit, at most a quarter of the stack
+#define STACK_RESERVE (256 * 1024)
+
+_Thread_local char *stackLimit = NULL;
+static _Thread_local int stackKnown = 0;
+
+
+// Sets stackLimit for the calling thread, once.
+void stackInitThread(){
+  if (stackKnown){
+    return;
+  }
+  stackKnown = 1;
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0){
+    return;
+  }
+  void *low;
+  size_t size;
+  if (pthread_attr_getstack(&attr, &low, &size) == 0){
+    size_t reserve = (size / 4 < STACK_RESERVE) ? size / 4 : STACK_RESERVE;
+    stackLimit = (char *)low + reserve;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+
+// Runs start(arg) on a new thread with a mapped stack of size bytes.
+int runOnStack(size_t size, void *(*start)(void *), void *arg){
+  size_t page = sysconf(_SC_PAGESIZE);
+  size = (size + page - 1) / page * page;
+  // pages are only backed by memory once touched, so a large stack costs
+  // what the program uses of it
+  char *base = mmap(NULL, size + page, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (base == MAP_FAILED){
+    return -1;
+  }
+  // the guard page, below the lowest address the stack grows to
+  if (mprotect(base, page, PROT_NONE) != 0){
+    munmap(base, size + page);
+    return -1;
+  }
+  pthread_attr_t attr;
+  pthread_t thread;
+  int status = -1;
+  if (pthread_attr_init(&attr) == 0){
+    if (pthread_attr_setstack(&attr, base + page, size) == 0 &&
+        pthread_create(&thread, &attr, start, arg) == 0){
+      pthread_join(thread, NULL);
+      status = 0;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  munmap(base, size + page);
+  return status;
+}
@@ -0,0 +1,31 @@
+#include <stddef.h>
+
+#ifndef _STACK
+#define _STACK
+
+// The native stack of the evaluating threads. eval() recurses on the C stack
+// for every nested call that is not a tail call, so a deep enough recursion
+// would run off the end of it and crash. Instead, eval() compares its frame
+// address with stackLimit, which stackInitThread() sets a reserve above the
+// low end of the calling thread's stack (stacks grow down), and raises a
+// "stack overflow" evaluation error when it gets below. The reserve leaves
+// room for the primitives, error reporting and the C library that run
+// between two calls of eval().
+//
+// runOnStack() gives a program a bigger stack than the one the process
+// started with (./interpreter --stack-size=MB).
+
+// the lowest frame address eval() may run at on this thread (NULL if not
+// known, so that nothing is checked)
+extern _Thread_local char *stackLimit;
+
+// Sets stackLimit for the calling thread from the bounds of its stack, the
+// first time it is called on the thread.
+void stackInitThread();
+
+// Runs start(arg) on a new thread whose stack is size bytes of memory mapped
+// for it, with an inaccessible guard page below, and waits for it to return.
+// Returns 0, or -1 if the stack or the thread could not be made.
+int runOnStack(size_t size, void *(*start)(void *), void *arg);
+
+#endif
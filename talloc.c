@@ -1,91 +1,276 @@
 #include <stdlib.h>
 #include <assert.h>
+#include <setjmp.h>
+#include <pthread.h>
 #include "value.h"
 #include "talloc.h"
+#include "heap.h"
+#include "counters.h"
 
 
-// activeListHead is a global variable
-// that stores the pointers of memory allocated by
-// talloc in the object files in a linked list 
-// that uses malloc 
-Value *activeListHead;
+// the heap of the process, used unless an interpreter
+// context (see interp.h) switches to its own
+Heap defaultHeap = { .slabList = NULL, .largeList = NULL, .id = 1,
+                     .lock = PTHREAD_MUTEX_INITIALIZER, .collected = 0 };
+_Thread_local Heap *currentHeap = &defaultHeap;
 
+// ids of the heaps created by heapCreate()
+long lastHeapId = 1;
 
-// Create a new NULL_TYPE value node using malloc.
-// This is a duplicate of the makeNull() function in linkedlist.c
-Value *makeNullHelper(){
-  Value *newVal = malloc(sizeof(Value));
-  newVal->type = NULL_TYPE;
-  return newVal;
+// each thread allocates from its own pools, so the common
+// path of talloc needs no locking. The pools serve the heap
+// whose id is poolsHeapId.
+_Thread_local Pool pools[NUM_CLASSES];
+_Thread_local long poolsHeapId = 1;
+
+_Thread_local jmp_buf *exitTrap = NULL;
+
+
+// returns the index of the size class serving the given size
+// (size must be between 1 and MAX_SMALL_SIZE)
+int sizeClass(size_t size){
+  return (int)((size + GRANULE - 1) / GRANULE) - 1;
+}
+
+
+// returns the slab holding a small talloc'd cell
+Slab *slabOf(void *cell){
+  return (Slab *)((uintptr_t)cell & ~(uintptr_t)(SLAB_SIZE - 1));
 }
 
 
-// Create a PTR_TYPE value node using malloc.
-Value *makePtrHelper(void *p){
-  Value *newVal = malloc(sizeof(Value));
-  newVal->type = PTR_TYPE;
-  newVal->p = p;
-  return newVal;
+// returns the index of a cell within its slab
+size_t cellIndex(Slab *slab, void *cell){
+  return (size_t)((char *)cell - slab->firstCell) / slab->cellSize;
 }
 
 
-// Create a new CONS_TYPE value node using malloc.
-// This is a duplicate of the cons() function in linkedlist.c
-Value *consHelper(Value *newCar, Value *newCdr){
-  Value *newVal = malloc(sizeof(Value));
-  newVal->type = CONS_TYPE;
-  (newVal->c).car = newCar;
-  (newVal->c).cdr = newCdr;
-  return newVal;
+// returns the calling thread's pool of the given size class, emptying
+// the pools first if they were serving another heap (whatever was left
+// in them stays with that heap)
+Pool *poolOf(int class){
+  if (poolsHeapId != currentHeap->id){
+    for (int i = 0; i < NUM_CLASSES; i++){
+      pools[i].freeList = NULL;
+      pools[i].bump = NULL;
+      pools[i].limit = NULL;
+    }
+    poolsHeapId = currentHeap->id;
+  }
+  return &pools[class];
+}
+
+
+// gives the pool of the given size class a fresh slab to bump-allocate from
+void addSlab(int class){
+  Slab *slab = aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+  assert(slab != NULL && "Error (talloc): out of memory");
+  slab->cellSize = (size_t)(class + 1) * GRANULE;
+  // the first cell starts after the header, on a 16-byte boundary
+  slab->firstCell = (char *)slab + ((sizeof(Slab) + 15) & ~(size_t)15);
+  slab->numCells = (size_t)((char *)slab + SLAB_SIZE - slab->firstCell) / slab->cellSize;
+  Heap *heap = currentHeap;
+  pthread_mutex_lock(&heap->lock);
+  slab->next = heap->slabList;
+  heap->slabList = slab;
+  pthread_mutex_unlock(&heap->lock);
+  Pool *pool = poolOf(class);
+  pool->bump = slab->firstCell;
+  pool->limit = slab->firstCell + slab->numCells * slab->cellSize;
+  if (heap->collected){
+    gcNoteSlab(slab);
+  }
+}
+
+
+// malloc's a block that is too big for the size classes
+// and records it for tfree()
+void *tallocLarge(size_t size){
+  LargeBlock *block = malloc(sizeof(LargeBlock) + size);
+  assert(block != NULL && "Error (talloc): out of memory");
+  block->size = size;
+  block->marked = 0;
+  Heap *heap = currentHeap;
+  pthread_mutex_lock(&heap->lock);
+  block->next = heap->largeList;
+  block->prev = NULL;
+  if (heap->largeList != NULL){
+    heap->largeList->prev = block;
+  }
+  heap->largeList = block;
+  pthread_mutex_unlock(&heap->lock);
+  return block + 1;
 }
 
 
-// Replacement for malloc that stores the pointers allocated. It should store
-// the pointers in some kind of list; a linked list would do fine, but insert
-// here whatever code you'll need to do so; don't call functions in the
-// pre-existing linkedlist.h. Otherwise you'll end up with circular
-// dependencies, since you're going to modify the linked list to use talloc.
+// Replacement for malloc that takes the memory from the pool of the
+// matching size class (or from malloc, for large sizes) and keeps track of
+// it, so that tfree() can release all of it at once.
 void *talloc(size_t size){
-  // let head point to a NULL_TYPE node if active list is empty
-  if (activeListHead == NULL){
-    activeListHead = makeNullHelper();
+  if (countingOn){
+    countEvents(COUNT_TALLOC, 1);
+    countEvents(COUNT_TALLOC_BYTES, size == 0 ? 1 : size);
   }
-  // malloc the memory for return
-  void *newPointer = malloc(size);
-  // store this pointer into the active list by modifying
-  // activeListHead, where we insert a new node after the activeListHead
-  activeListHead = consHelper(makePtrHelper(newPointer),activeListHead);
-  return newPointer;
+  return tallocUncounted(size);
 }
 
-// Free all pointers allocated by talloc, as well as whatever memory you
-// allocated in lists to hold those pointers.
+
+// talloc() without counting it
+void *tallocUncounted(size_t size){
+  if (size == 0){
+    size = 1;
+  }
+  void *cell;
+  if (size > MAX_SMALL_SIZE){
+    cell = tallocLarge(size);
+  }
+  else{
+    int class = sizeClass(size);
+    Pool *pool = poolOf(class);
+    // reuse a reclaimed cell if there is one
+    if (pool->freeList != NULL){
+      cell = pool->freeList;
+      pool->freeList = *(void **)cell;
+    }
+    else{
+      size_t cellSize = (size_t)(class + 1) * GRANULE;
+      if (pool->bump == NULL || pool->bump + cellSize > pool->limit){
+        addSlab(class);
+      }
+      cell = pool->bump;
+      pool->bump += cellSize;
+    }
+  }
+  if (currentHeap->collected){
+    gcNoteAlloc(cell, size);
+  }
+  return cell;
+}
+
+
+// takes a large block out of the list of its heap and frees it
+static void releaseLarge(LargeBlock *block){
+  Heap *heap = currentHeap;
+  pthread_mutex_lock(&heap->lock);
+  if (block->prev == NULL){
+    heap->largeList = block->next;
+  }
+  else{
+    block->prev->next = block->next;
+  }
+  if (block->next != NULL){
+    block->next->prev = block->prev;
+  }
+  pthread_mutex_unlock(&heap->lock);
+  free(block);
+}
+
+
+// Hands a cell back to the pool of its size class, where the next talloc
+// of that size will reuse it. size must be the size it was talloc'd with.
+void trelease(void *pointer, size_t size){
+  if (pointer == NULL){
+    return;
+  }
+  if (size > MAX_SMALL_SIZE){
+    // a large block goes back to malloc, unless the collector manages the
+    // heap: it may still have the block to scan, and frees it once
+    // nothing points to it
+    if (!currentHeap->collected){
+      releaseLarge((LargeBlock *)pointer - 1);
+    }
+    return;
+  }
+  if (size == 0){
+    size = 1;
+  }
+  if (currentHeap->collected){
+    gcNoteRelease(pointer, size);
+  }
+  Pool *pool = poolOf(sizeClass(size));
+  *(void **)pointer = pool->freeList;
+  pool->freeList = pointer;
+}
+
+
+// Frees every slab and large block of heap and empties the calling
+// thread's pools if they serve it.
+void freeHeap(Heap *heap){
+  while (heap->slabList != NULL){
+    Slab *next = heap->slabList->next;
+    free(heap->slabList);
+    heap->slabList = next;
+  }
+  while (heap->largeList != NULL){
+    LargeBlock *next = heap->largeList->next;
+    free(heap->largeList);
+    heap->largeList = next;
+  }
+  if (poolsHeapId == heap->id){
+    for (int i = 0; i < NUM_CLASSES; i++){
+      pools[i].freeList = NULL;
+      pools[i].bump = NULL;
+      pools[i].limit = NULL;
+    }
+  }
+  if (heap->collected){
+    gcReset();
+  }
+}
+
+
+// Free all pointers allocated by talloc, i.e. every slab and large block,
+// and empty all the pools. Other threads must not be using talloc'd memory
+// anymore.
 void tfree(){
-  assert(activeListHead != NULL && "Error (tfree): active list is empty");
-  Value *cur = activeListHead;
-  while (cur->type != NULL_TYPE){
-    // save the next node's address
-    Value *next = (cur->c).cdr;
-    // free up the address stored in the Value pointed to by car, i.e. the talloc'd address
-    free(((cur->c).car)->p);
-    // free up the Value pointed to by car
-    free((cur->c).car);
-    // free the CONS_TYPE Value that holds the car and cdr
-    free(cur);
-    // advance the cur to the next CONS_TYPE Value
-    cur = next;
-  }
-  // free up the final NULL_TYPE Value
-  free(cur);
-  // make the active list empty
-  activeListHead = NULL;
+  freeHeap(currentHeap);
   return;
 }
 
-// Replacement for the C function "exit", that consists of two lines: it calls
-// tfree before calling exit. It's useful to have later on; if an error happens,
+// Replacement for the C function "exit": it calls tfree, then exit, which runs
+// the atexit handlers. Under --count those print each counter as a
+// "<name> <total>" line to stderr, then a "primitive:<name> <calls>" line for
+// each primitive that was called (see countersPrint()). If an error happens,
 // you can exit your program, and all memory is automatically cleaned up.
+// Inside an interpreter context, it jumps to exitTrap instead, and the heap
+// stays valid.
 void texit(int status){
+  if (exitTrap != NULL){
+    longjmp(*exitTrap, (status == 0) ? 1 : status);
+  }
   tfree();
   exit(status);
-}
\ No newline at end of file
+}
+
+
+// Creates an empty heap.
+Heap *heapCreate(){
+  Heap *heap = malloc(sizeof(Heap));
+  assert(heap != NULL && "Error (heapCreate): out of memory");
+  heap->slabList = NULL;
+  heap->largeList = NULL;
+  heap->id = __atomic_add_fetch(&lastHeapId, 1, __ATOMIC_RELAXED);
+  pthread_mutex_init(&heap->lock, NULL);
+  heap->collected = 0;
+  return heap;
+}
+
+
+// Frees a heap created by heapCreate() and all the memory talloc'd from it.
+void heapDestroy(Heap *heap){
+  freeHeap(heap);
+  pthread_mutex_destroy(&heap->lock);
+  free(heap);
+}
+
+
+// Returns the heap talloc uses on the calling thread.
+Heap *activeHeap(){
+  return currentHeap;
+}
+
+
+// Makes talloc use heap on the calling thread.
+void setActiveHeap(Heap *heap){
+  currentHeap = heap;
+}
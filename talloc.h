@@ -1,24 +1,55 @@
 #include <stdlib.h>
+#include <setjmp.h>
 #include "value.h"
 
 #ifndef _TALLOC
 #define _TALLOC
 
-// Replacement for malloc that stores the pointers allocated. It should store
-// the pointers in some kind of list; a linked list would do fine, but insert
-// here whatever code you'll need to do so; don't call functions in the
-// pre-existing linkedlist.h. Otherwise you'll end up with circular
-// dependencies, since you're going to modify the linked list to use talloc.
+// Replacement for malloc that keeps track of the memory allocated. Small sizes
+// (such as sizeof(Value) and sizeof(Frame)) are served from per-size-class
+// pools of slab memory; larger ones are malloc'd. Don't call functions in
+// linkedlist.h from here, since the linked list uses talloc.
 void *talloc(size_t size);
 
-// Free all pointers allocated by talloc, as well as whatever memory you
-// allocated in lists to hold those pointers.
+// talloc(), but left out of the talloc counts (see counters.h), for memory
+// whose amount differs from run to run.
+void *tallocUncounted(size_t size);
+
+// Hands memory obtained from talloc(size) back to its pool so that a later
+// talloc of the same size class can reuse it (a large block is freed, unless
+// the collector manages the heap). Only call this when nothing refers to the
+// memory anymore, on a thread using the heap it was talloc'd from.
+void trelease(void *pointer, size_t size);
+
+// Free all pointers allocated by talloc, as well as the pools holding them.
 void tfree();
 
-// Replacement for the C function "exit", that consists of two lines: it calls
-// tfree before calling exit. It's useful to have later on; if an error happens,
-// you can exit your program, and all memory is automatically cleaned up.
+// Replacement for the C function "exit": it calls tfree, then exit, whose
+// atexit handlers print the --count counters to stderr (see countersPrint()).
+// If an error happens, you can exit your program, and all memory is
+// automatically cleaned up.
+// If exitTrap is set on the calling thread, it longjmps there instead (with
+// status, or 1 if status is 0) and frees nothing.
 void texit(int status);
+extern _Thread_local jmp_buf *exitTrap;
+
+// A heap is all the memory talloc'd for one interpreter (see interp.h). Each
+// thread talloc's from its active heap, which is the heap of the process
+// unless it is changed with setActiveHeap(); tfree() frees the active heap.
+typedef struct Heap Heap;
+
+// Creates an empty heap.
+Heap *heapCreate();
+
+// Frees a heap created by heapCreate() and all the memory talloc'd from it.
+// No thread may be using it anymore.
+void heapDestroy(Heap *heap);
+
+// Returns the heap talloc uses on the calling thread.
+Heap *activeHeap();
+
+// Makes talloc use heap on the calling thread.
+void setActiveHeap(Heap *heap);
 
 #endif
 
@@ -0,0 +1,11 @@
+(define sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))
+(define x 1)
+(define f (future (+ (sum 3000) x)))
+(set! x 100)
+(touch f)
+(define g (future (+ (sum 2000) x)))
+(define x2 (touch g))
+x2
+(let* ((y 5) (h (future (+ (sum 1000) y))) (z 7))
+  (set! y 6)
+  (+ (touch h) z))
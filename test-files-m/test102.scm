@@ -0,0 +1,2 @@
+(display "never runs")
+(display 1/2/3)
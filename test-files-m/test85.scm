@@ -0,0 +1,2 @@
+(define fib (lambda (n) (if (< n 2) n (pcall + (fib (- n 1)) (fib (- n 2))))))
+(let ((a (fib 10)) (b (fib 11))) (pcall - b a))
@@ -0,0 +1,2 @@
+(define sum (lambda (lo hi) (if (< (- hi lo) 2) lo (let ((a (future (sum lo (- hi 1))))) (+ (touch a) (- hi 1))))))
+(sum 0 10)
@@ -0,0 +1,10 @@
+(guard (e (#t e)) (car 1))
+(guard (e ((= e 3) (quote three)) (else (quote other))) (raise 3))
+(guard (e ((= e 3) (quote three)) (else (quote other))) (raise 4))
+(guard (e (#f 1)) (+ 1 2))
+(with-exception-handler (lambda (c) (+ c 1)) (lambda () (raise 41)))
+(with-exception-handler (lambda (c) c) (lambda () (+ 1 (cdr 5))))
+(define safe-div (lambda (x) (guard (e (else 0)) (if (= x 0) (raise x) x))))
+(safe-div 0)
+(safe-div 7)
+(guard (e ((= e 1) 1)) (guard (e ((= e 2) 2)) (raise 1)))
@@ -0,0 +1,4 @@
+(load "test-files-m/test85.scm")
+(fib 12)
+(let ((file "test-files-m/test85.scm")) (begin (load file) (fib 6)))
+(load "test-files-m/no-such-file.scm")
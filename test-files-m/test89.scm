@@ -0,0 +1,14 @@
+(display 5)
+(newline)
+(display "hi there")
+(newline)
+(display (quote (1 (2 "s" 3.5) #t x)))
+(newline)
+(display (cons 1 2))
+(newline)
+(display (car (quote ((a b) c))))
+(display (cdr (quote (a))))
+(newline)
+(define f (lambda (n) (if (= n 0) 0 (begin (display n) (display " ") (f (- n 1))))))
+(f 5)
+(display 1 2)
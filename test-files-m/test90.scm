@@ -0,0 +1,30 @@
+(list 1 2 (quote (3 4)) "s")
+(list)
+(append (quote (1 2)) (quote (3)) (quote ()) (quote (4 5)))
+(append (quote (1)) 2)
+(append)
+(append (quote ()) (quote (1)))
+(length (quote (1 2 (3 4))))
+(length (quote ()))
+(reverse (quote (1 (2 3) 4)))
+(list-tail (quote (1 2 3)) 1)
+(list-tail (quote (1 2 3)) 3)
+(map (lambda (x) (+ x 1)) (quote (1 2 3)))
+(map + (quote (1 2 3)) (quote (10 20)))
+(map (lambda (x) (list x x)) (quote (1 2)))
+(map car (quote ((1 2) (3 4))))
+(for-each display (quote (1 2 3)))
+(filter (lambda (x) (> x 2)) (quote (1 5 2 7)))
+(fold-left + 0 (quote (1 2 3 4)))
+(fold-left (lambda (acc x) (cons x acc)) (quote ()) (quote (1 2 3)))
+(member 2 (quote (1 2 3)))
+(member (quote (2)) (quote (1 (2) 3)))
+(member 9 (quote (1 2 3)))
+(assoc (quote b) (quote ((a 1) (b 2))))
+(assoc "x" (quote (("y" . 1))))
+(+ (car (quote (1 2))) 1)
+(car (quote ((1 2) 3)))
+(define sum (lambda (l) (if (null? l) 0 (+ (car l) (sum (cdr l))))))
+(sum (quote (1 2 3 4)))
+(length (cons 1 (quote (2))))
+(length (cons 1 2))
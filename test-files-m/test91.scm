@@ -0,0 +1,25 @@
+(eq? (quote a) (quote a))
+(eq? 1000000 1000000)
+(eq? (quote (1 2)) (quote (1 2)))
+(eq? (list 1 2) (list 1 2))
+(eq? (quote ()) (list))
+(eq? 1.5 1.5)
+(eqv? 1.5 1.5)
+(eqv? "a" "a")
+(equal? "a" "a")
+(equal? (list 1 (list 2 "x") 3.5) (quote (1 (2 "x") 3.5)))
+(equal? (list 1 2) (list 1 2 3))
+(equal? (cons 1 2) (cons 1 2))
+(equal? (cons 1 2) (cons 1 3))
+(equal? (quote (1 ())) (list 1 (list)))
+(equal? 1 1.0)
+(equal? car car)
+(equal? (cons 1 (quote ())) (list 1))
+(= (equal-hash (list 1 (list 2 "x"))) (equal-hash (quote (1 (2 "x")))))
+(= (equal-hash (cons 1 (quote ()))) (equal-hash (list 1)))
+(= (equal-hash "abcdefghijkl") (equal-hash "abcdefghijkm"))
+(= (equal-hash (quote a)) (equal-hash "a"))
+(define l (list 1 2))
+(eq? l l)
+(eq? (car (quote ((1)))) (car (quote ((1)))))
+(equal? 1)
@@ -0,0 +1,22 @@
+(define-memoized (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+(fib 30)
+(memoize-stats fib)
+(fib 30)
+(memoize-stats fib)
+(define slow (lambda (a b) (display a) (+ a b)))
+(define fast (memoize slow 2))
+(fast 1 2)
+(fast 1 2)
+(fast 3 4)
+(fast 5 6)
+(fast 1 2)
+(memoize-stats fast)
+(define-memoized (k) (display 7) 8)
+(k)
+(k)
+(define-memoized (len l) (if (null? l) 0 (+ 1 (len (cdr l)))))
+(len (quote (1 2 3)))
+(len (quote (1 2 3)))
+(memoize-stats len)
+(map fib (quote (10 20)))
+(memoize car)
@@ -0,0 +1,27 @@
+(string-length "hello")
+(string-length "héllo wörld")
+(string-append "ab" "cd" "")
+(string-append)
+(define s (string-append "abc" "def"))
+(define t (string-append s "X"))
+(define u (string-append s "Y"))
+t
+u
+s
+(substring "hello world" 6)
+(substring "héllo wörld" 1 4)
+(substring "héllo" 5 5)
+(string=? "abc" (substring "xabcx" 1 4))
+(string=? "abc" "abd")
+(string=? "a" "a" "a")
+(string->symbol (substring "xfoo" 1))
+(eq? (string->symbol "car") (quote car))
+(number->string 42)
+(number->string -1.5)
+(equal? (string-append "a" "b") "ab")
+(= (equal-hash (substring "zab" 1)) (equal-hash "ab"))
+(define build (lambda (s n) (if (= n 0) s (build (string-append s "ab") (- n 1)))))
+(string-length (build "" 10000))
+(display (substring "héllo" 1 3))
+(newline)
+(substring "abc" 2 1)
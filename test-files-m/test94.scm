@@ -0,0 +1,21 @@
+1e3
+-2.5E-2
+1.5e+2
+(+ 1e2 1)
+12.
+.25
+-0.125
+#x1F
+#xff
+#x-10
+(+ #xA 1)
+6/3
+-7/2
+1/8
+(quote (1/2 #x10 2e1))
+3.14159265358979323846
+0.30000000000000004
+123456789012345678901234567890.0
+(+ 1e-5 1e5)
+(= 0.1 1e-1)
+(eqv? 2.5 25e-1)
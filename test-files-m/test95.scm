@@ -0,0 +1,24 @@
+'x
+'(1 2 3)
+''a
+'()
+(quote (a . b))
+'(a . b)
+'(1 2 . 3)
+'(a . (b c))
+'(a . ())
+(car '(a . b))
+(cdr '(a . b))
+(cdr '(1 2 . 3))
+(define alist '((a . 1) (b . 2) [c . 3]))
+(assoc 'b alist)
+(cdr (assoc 'c alist))
+[+ 1 2]
+(let ([x 1] [y 2]) (+ x y))
+(equal? '(a . b) (cons 'a 'b))
+(eq? '(1 2) '(1 2))
+(eq? (car ''x) 'quote)
+'(1 . 2.5)
+'[a b]
+'(a 'b)
+(length '(a . (b . (c . ()))))
@@ -0,0 +1,8 @@
+(define count (lambda (n) (if (= n 0) 0 (+ 1 (count (- n 1))))))
+(count 3000)
+(define forever (lambda (n) (+ 1 (forever n))))
+(guard (e (#t "overflow caught")) (forever 0))
+(with-exception-handler (lambda (e) 'handled) (lambda () (forever 0)))
+(count 3000)
+(forever 0)
+(count 1)
@@ -0,0 +1,2 @@
+(display "never runs")
+(car (quote (1 2))))
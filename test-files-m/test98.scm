@@ -0,0 +1,5 @@
+(guard (e (#t e)) (load "test-files-m/test97.scm"))
+(with-exception-handler (lambda (e) 'handled) (lambda () (load "test-files-m/test97.scm")))
+(+ 1 2)
+(load "test-files-m/test97.scm")
+(+ 3 4)
@@ -0,0 +1,6 @@
+(display -2147483648) (newline)
+(display 2147483647) (newline)
+(display -4294967296/2) (newline)
+(display 4294967294/2) (newline)
+(display #x7fffffff) (newline)
+(display #x-80000000) (newline)
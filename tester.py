@@ -199,3 +199,113 @@ def runIt(test_dir, valgrind=True) -> None:
                 print('---VALGRIND NO ERROR---')
 
     return error_encountered
+
+
+COUNTS_HEADER = ('# Event counts of each test (./interpreter --count), '
+                 'checked by count-m.\n'
+                 '# Regenerate with ./count-m --update after a change that '
+                 'is meant to change them.\n')
+
+
+def get_counts(command, test_path) -> dict:
+    '''Runs a test and returns the counters it printed to stderr, or None if
+    it crashed or timed out.'''
+    try:
+        with open(test_path, 'r') as input_file:
+            process = subprocess.run(
+                command,
+                stdin=input_file,
+                stderr=subprocess.PIPE,
+                stdout=subprocess.DEVNULL,
+                timeout=10)
+    except subprocess.TimeoutExpired:
+        return None
+    if process.returncode < 0:
+        return None
+    counts = {}
+    for line in process.stderr.decode('utf-8').splitlines():
+        fields = line.split()
+        if len(fields) == 2 and fields[1].isdigit():
+            counts[fields[0]] = int(fields[1])
+    return counts
+
+
+def read_counts(baseline_path) -> dict:
+    '''Reads a baseline file of "test counter value" lines.'''
+    baseline = collections.defaultdict(dict)
+    with open(baseline_path, 'r') as baseline_file:
+        for line in baseline_file:
+            fields = line.split()
+            if len(fields) == 3 and not line.startswith('#'):
+                baseline[fields[0]][fields[1]] = int(fields[2])
+    return baseline
+
+
+def write_counts(baseline_path, all_counts) -> None:
+    with open(baseline_path, 'w') as baseline_file:
+        baseline_file.write(COUNTS_HEADER)
+        for test_name in sorted(all_counts):
+            for counter, value in all_counts[test_name].items():
+                baseline_file.write('%s %s %d\n' % (test_name, counter, value))
+
+
+def countIt(test_dir, baseline_path, update=False, tolerance=0.0):
+    '''Compares the counts of each test with the baseline, and fails if any
+    grew by more than tolerance (a fraction). With update, writes the counts
+    as the new baseline instead.'''
+
+    returncode = buildCode()
+    if returncode != 0:
+        return returncode
+
+    # a recursion too deep for the stack stops at a depth that depends on
+    # where the stack starts, so the tests run with a lower limit
+    command = ['./interpreter', '--count', '--max-depth=5000']
+
+    test_names = [test_name.split('.')[0]
+                  for test_name in sorted(os.listdir(test_dir))
+                  if test_name.split('.')[1] == 'scm']
+
+    all_counts = {}
+    error_encountered = False
+    for test_name in test_names:
+        counts = get_counts(command,
+                            os.path.join(test_dir, test_name + '.scm'))
+        if counts is None:
+            print('------Test', test_name, '------')
+            print('---CRASHED OR TIMED OUT---')
+            error_encountered = True
+        else:
+            all_counts[test_name] = counts
+
+    if update:
+        write_counts(baseline_path, all_counts)
+        print('Wrote', baseline_path)
+        return error_encountered
+
+    baseline = read_counts(baseline_path)
+    for test_name in test_names:
+        if test_name not in all_counts:
+            continue
+        if test_name not in baseline:
+            print('------Test', test_name, '------')
+            print('---NOT IN BASELINE---')
+            continue
+        changes = []
+        for counter, value in all_counts[test_name].items():
+            old = baseline[test_name].get(counter, 0)
+            if value > old * (1 + tolerance):
+                changes.append('REGRESSION %s: %d -> %d' % (counter, old, value))
+                error_encountered = True
+            elif value != old:
+                changes.append('changed %s: %d -> %d' % (counter, old, value))
+        if changes:
+            print('------Test', test_name, '------')
+            for change in changes:
+                print(change)
+
+    if error_encountered:
+        print('---COUNTS REGRESSED---')
+    else:
+        print('---COUNTS OK---')
+    return error_encountered
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include "value.h"
+#include "talloc.h"
+#include "text.h"
+
+// the longest string, in bytes (so that a buffer of twice its
+// length still fits in an int)
+#define MAX_STRING_LENGTH (INT_MAX / 2 - 16)
+
+// the smallest buffer string-append makes
+#define MIN_BUFFER_CAPACITY 32
+
+// A string buffer is talloc'd as one block with its text. used is the
+// length of the longest string made in it so far, whose text the next
+// in-place append continues; it only ever grows. The bytes from used
+// up to capacity are zero.
+struct StringBuffer {
+  int capacity;
+  int used;
+  char bytes[];
+};
+
+typedef struct StringBuffer StringBuffer;
+
+
+// returns a new STR_TYPE Value for the text at s
+static Value *newString(char *s, int length, int chars, int inBuffer){
+  Value *string = talloc(sizeof(Value));
+  string->type = STR_TYPE;
+  string->s = s;
+  string->length = length;
+  string->chars = chars;
+  string->inBuffer = inBuffer;
+  return string;
+}
+
+
+// Returns a new string holding a copy of the length bytes at bytes.
+Value *makeString(const char *bytes, int length){
+  char *s = talloc(length + 1);
+  memcpy(s, bytes, length);
+  s[length] = '\0';
+  return newString(s, length, countChars(s, length), 0);
+}
+
+
+// Returns the number of characters in the length bytes of UTF-8 at bytes.
+int countChars(const char *bytes, int length){
+  int chars = 0;
+  int i = 0;
+  // ASCII text is skipped a word at a time
+  for (; i + (int)sizeof(uint64_t) <= length; i += sizeof(uint64_t)){
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    if ((word & 0x8080808080808080ULL) == 0){
+      chars += sizeof(uint64_t);
+    }
+    else{
+      for (int j = 0; j < (int)sizeof(uint64_t); j++){
+        chars += (bytes[i + j] & 0xC0) != 0x80;
+      }
+    }
+  }
+  for (; i < length; i++){
+    chars += (bytes[i] & 0xC0) != 0x80;
+  }
+  return chars;
+}
+
+
+// Returns a string of the count strings in strings one after the other,
+// or NULL if it would be too long.
+Value *stringAppend(Value **strings, int count){
+  if (count == 0){
+    return makeString("", 0);
+  }
+  long total = 0;
+  long chars = 0;
+  for (int i = 0; i < count; i++){
+    total += strings[i]->length;
+    chars += strings[i]->chars;
+  }
+  if (total > MAX_STRING_LENGTH){
+    return NULL;
+  }
+  Value *first = strings[0];
+  if (total == first->length){
+    // (strings never change, so the first one can be the result)
+    return first;
+  }
+  if (first->inBuffer){
+    // the text goes right after the first string in its buffer, if no
+    // string made earlier continues it there and it still fits
+    StringBuffer *buffer = (StringBuffer *)(first->s - offsetof(StringBuffer, bytes));
+    int expected = first->length;
+    if (total < buffer->capacity &&
+        __atomic_compare_exchange_n(&buffer->used, &expected, (int)total, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+      char *end = first->s + first->length;
+      for (int i = 1; i < count; i++){
+        memcpy(end, strings[i]->s, strings[i]->length);
+        end += strings[i]->length;
+      }
+      return newString(first->s, (int)total, (int)chars, 1);
+    }
+  }
+  // a new buffer, with room to append as much again in place
+  int capacity = (int)(2 * total + 1);
+  if (capacity < MIN_BUFFER_CAPACITY){
+    capacity = MIN_BUFFER_CAPACITY;
+  }
+  StringBuffer *buffer = talloc(offsetof(StringBuffer, bytes) + capacity);
+  buffer->capacity = capacity;
+  buffer->used = (int)total;
+  char *end = buffer->bytes;
+  for (int i = 0; i < count; i++){
+    memcpy(end, strings[i]->s, strings[i]->length);
+    end += strings[i]->length;
+  }
+  memset(end, 0, capacity - total);
+  return newString(buffer->bytes, (int)total, (int)chars, 1);
+}
+
+
+// returns the offset in bytes of character index of string
+// (which is at most its number of characters)
+static int charOffset(Value *string, int index){
+  if (string->chars == string->length){
+    // only ASCII
+    return index;
+  }
+  if (index == (int)string->chars){
+    return string->length;
+  }
+  int offset = 0;
+  int charsBefore = -1;
+  while (1){
+    if ((string->s[offset] & 0xC0) != 0x80){
+      charsBefore++;
+      if (charsBefore == index){
+        return offset;
+      }
+    }
+    offset++;
+  }
+}
+
+
+// Returns the substring of string from character start up to character
+// end, sharing its text, or NULL if they are out of range.
+Value *substring(Value *string, int start, int end){
+  if (start < 0 || start > end || end > (int)string->chars){
+    return NULL;
+  }
+  int startOffset = charOffset(string, start);
+  int endOffset = charOffset(string, end);
+  return newString(string->s + startOffset, endOffset - startOffset, end - start, 0);
+}
+
+
+// Returns non-zero if the strings a and b hold the same text.
+int stringsEqual(Value *a, Value *b){
+  return a->length == b->length && memcmp(a->s, b->s, a->length) == 0;
+}
+
+
+// Returns a new NUL-terminated copy of the text of string.
+char *stringToCString(Value *string){
+  char *s = talloc(string->length + 1);
+  memcpy(s, string->s, string->length);
+  s[string->length] = '\0';
+  return s;
+}
@@ -0,0 +1,42 @@
+#include "value.h"
+
+#ifndef _TEXT
+#define _TEXT
+
+// Strings. A STR_TYPE Value holds its length in bytes and in characters
+// (the text is UTF-8, and a character is a code point), so its text need
+// not end in a NUL byte: a substring is a Value pointing into the text of
+// the string it was taken from, without a copy. Strings never change once
+// made.
+//
+// string-append builds its result in a string buffer with room to spare,
+// and a later string-append whose first string is that result (the whole
+// text of the buffer so far) adds to the same buffer in place. The
+// unused part of a buffer is zeroed, so the text of every string in one
+// is followed by a NUL byte somewhere. Repeatedly appending to a string
+// thus takes time linear in the final length.
+
+// Returns a new string holding a copy of the length bytes at bytes.
+Value *makeString(const char *bytes, int length);
+
+// Returns the number of characters in the length bytes of UTF-8 at bytes
+// (the bytes that don't continue a multi-byte character).
+int countChars(const char *bytes, int length);
+
+// Returns a string of the count strings in strings one after the other,
+// or NULL if it would be too long to represent.
+Value *stringAppend(Value **strings, int count);
+
+// Returns the substring of string from character start up to character
+// end (not included), sharing its text, or NULL unless
+// 0 <= start <= end <= the number of characters of string.
+Value *substring(Value *string, int start, int end);
+
+// Returns non-zero if the strings a and b hold the same text.
+int stringsEqual(Value *a, Value *b);
+
+// Returns a new NUL-terminated copy of the text of string (e.g. to name a
+// file or a symbol).
+char *stringToCString(Value *string);
+
+#endif
@@ -1,168 +1,450 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "value.h"
 #include "talloc.h"
 #include "linkedlist.h"
 #include "tokenizer.h"
+#include "intern.h"
+#include "parser.h"
+#include "text.h"
+#include "decimal.h"
 
 
+// The input is tokenized from memory. cursor is the next byte to read on
+// this thread, and inputEnd the end. Like the result of (char)fgetc(), a
+// 0xFF byte reads as EOF.
+_Thread_local const char *cursor = NULL;
+_Thread_local const char *inputEnd = NULL;
+
+
+// returns the next character of the input, or EOF at its end
+static char nextChar(){
+  if (cursor == inputEnd){
+    return (char)EOF;
+  }
+  char next = *cursor;
+  cursor++;
+  return next;
+}
+
+
+// Character classes, for the tokenizer to tell with one table lookup
+// what a character can be part of
+#define CHAR_DIGIT 1
+// can start a symbol: a letter or one of !$%&*/:<=>?~_^
+#define CHAR_INITIAL 2
+// can be in a symbol after its first character
+#define CHAR_SUBSEQUENT 4
+// ends a symbol: whitespace, a comment, a parenthesis or bracket, a string
+// or a boolean
+#define CHAR_DELIMITER 8
+
+#define INITIAL (CHAR_INITIAL | CHAR_SUBSEQUENT)
+
+static const unsigned char charClass[256] = {
+  ['0' ... '9'] = CHAR_DIGIT | CHAR_SUBSEQUENT,
+  ['a' ... 'z'] = INITIAL,
+  ['A' ... 'Z'] = INITIAL,
+  ['!'] = INITIAL, ['$'] = INITIAL, ['%'] = INITIAL, ['&'] = INITIAL,
+  ['*'] = INITIAL, ['/'] = INITIAL, [':'] = INITIAL, ['<'] = INITIAL,
+  ['='] = INITIAL, ['>'] = INITIAL, ['?'] = INITIAL, ['~'] = INITIAL,
+  ['_'] = INITIAL, ['^'] = INITIAL,
+  ['.'] = CHAR_SUBSEQUENT, ['+'] = CHAR_SUBSEQUENT, ['-'] = CHAR_SUBSEQUENT,
+  ['\n'] = CHAR_DELIMITER, [' '] = CHAR_DELIMITER, ['"'] = CHAR_DELIMITER,
+  ['('] = CHAR_DELIMITER, [')'] = CHAR_DELIMITER, [';'] = CHAR_DELIMITER,
+  ['#'] = CHAR_DELIMITER, ['['] = CHAR_DELIMITER, [']'] = CHAR_DELIMITER,
+};
+
+
+// Scanning. Comments, strings and symbols are skipped by searching for the
+// byte that ends them, 32 bytes at a time with AVX2 or 16 with SSE2 where
+// the processor has them (chosen once per process), and one at a time
+// otherwise. The searches never read past the end of the input.
+
+// the bytes that end a symbol (the delimiters of charClass, and EOF)
+static const char delimiters[] = "\n \"();#[]\xff";
+#define NUM_DELIMITERS 10
+
+// the most bytes one scan can search for
+#define MAX_NEEDLES 10
+
+// returns the first byte in [start, end) that is one of the count bytes
+// at needles, or end
+typedef const char *(*ScanFunction)(const char *start, const char *end, const char *needles, int count);
+
+static const char *scanScalar(const char *start, const char *end, const char *needles, int count){
+  for (const char *p = start; p < end; p++){
+    for (int k = 0; k < count; k++){
+      if (*p == needles[k]){
+        return p;
+      }
+    }
+  }
+  return end;
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static const char *scanSSE2(const char *start, const char *end, const char *needles, int count){
+  __m128i needleVectors[MAX_NEEDLES];
+  for (int k = 0; k < count; k++){
+    needleVectors[k] = _mm_set1_epi8(needles[k]);
+  }
+  const char *p = start;
+  for (; p + 16 <= end; p += 16){
+    __m128i block = _mm_loadu_si128((const __m128i *)p);
+    __m128i found = _mm_cmpeq_epi8(block, needleVectors[0]);
+    for (int k = 1; k < count; k++){
+      found = _mm_or_si128(found, _mm_cmpeq_epi8(block, needleVectors[k]));
+    }
+    int mask = _mm_movemask_epi8(found);
+    if (mask != 0){
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return scanScalar(p, end, needles, count);
+}
+
+
+__attribute__((target("avx2")))
+static const char *scanAVX2(const char *start, const char *end, const char *needles, int count){
+  __m256i needleVectors[MAX_NEEDLES];
+  for (int k = 0; k < count; k++){
+    needleVectors[k] = _mm256_set1_epi8(needles[k]);
+  }
+  const char *p = start;
+  for (; p + 32 <= end; p += 32){
+    __m256i block = _mm256_loadu_si256((const __m256i *)p);
+    __m256i found = _mm256_cmpeq_epi8(block, needleVectors[0]);
+    for (int k = 1; k < count; k++){
+      found = _mm256_or_si256(found, _mm256_cmpeq_epi8(block, needleVectors[k]));
+    }
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+    if (mask != 0){
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return scanSSE2(p, end, needles, count);
+}
+#endif
+
+
+static ScanFunction scan = scanScalar;
+static pthread_once_t scanOnce = PTHREAD_ONCE_INIT;
+
+
+// picks the fastest scan function the processor supports
+static void chooseScan(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")){
+    scan = scanAVX2;
+  }
+  else if (__builtin_cpu_supports("sse2")){
+    scan = scanSSE2;
+  }
+#endif
+}
+
+
+// Returns the first byte in [start, end) that is one of the count (at most
+// MAX_NEEDLES) bytes at needles, or end.
+const char *scanFor(const char *start, const char *end, const char *needles, int count){
+  pthread_once(&scanOnce, chooseScan);
+  return scan(start, end, needles, count);
+}
+
+
+// note: every token Value is taken from the literal pool,
+// so repeated tokens share one Value (and one string buffer)
 Value *readPar(Value *list, char type){
-  Value *newVal = talloc(sizeof(Value));
-  // parenthesis are stored as strings "(" or ")"
-  // in the s field of the new value
-  char *parString = talloc(2*sizeof(char));
+  Value newVal;
+  // parenthesis and brackets are stored as strings "(", ")",
+  // "[" or "]" in the s field of the new value
   if (type == '('){
-    newVal->type = OPEN_TYPE;
-    parString[0] = '(';
-    parString[1] = '\0';
+    newVal.type = OPEN_TYPE;
+    newVal.s = "(";
+  }
+  else if (type == ')'){
+    newVal.type = CLOSE_TYPE;
+    newVal.s = ")";
+  }
+  else if (type == '['){
+    newVal.type = OPENBRACKET_TYPE;
+    newVal.s = "[";
+  }
+  else{
+    newVal.type = CLOSEBRACKET_TYPE;
+    newVal.s = "]";
+  }
+  return cons(internAtom(&newVal), list);
+}
+
+
+// reads the mark of a quoted datum ('), or the dot of a dotted
+// list (.), which the parser puts together with what is around them
+Value *readMark(Value *list, char mark){
+  Value newVal;
+  if (mark == '\''){
+    newVal.type = SINGLEQUOTE_TYPE;
+    newVal.s = "'";
   }
   else{
-    newVal->type = CLOSE_TYPE;
-    parString[0] = ')';
-    parString[1] = '\0';
+    newVal.type = DOT_TYPE;
+    newVal.s = ".";
   }
-  newVal->s = parString;
-  return cons(newVal, list);
+  return cons(internAtom(&newVal), list);
 }
 
 
 Value *readBoolean(Value *list){
-  char next = (char)fgetc(stdin);
-  Value *newVal = talloc(sizeof(Value));
+  char next = nextChar();
+  Value newVal;
   if ((next == 't') || (next == 'f')){
-    newVal->type = BOOL_TYPE;
+    newVal.type = BOOL_TYPE;
     // booleans are stored as 0 or 1 in the i field
     if (next == 't'){
-      newVal->i = 1;
+      newVal.i = 1;
     }
     else{
-      newVal->i = 0;
+      newVal.i = 0;
     }
   }
   else{
-    printf("Syntax error (readBoolean): boolean was not #t or #f\n");
-    texit(1);
+    reportSyntaxError("Syntax error (readBoolean): boolean was not #t or #f\n");
   }
-  return cons(newVal, list);
+  return cons(internAtom(&newVal), list);
 }
 
 
 Value *readString(Value *list){
-  char next = (char)fgetc(stdin);
-  // strArr will store the string read (without the quotes)
-  char *strArr = talloc(301*sizeof(char));
-  int index = 0;
-  while (next != '"'){
-    // raise error if ending quotes are not detected
-    if (next == EOF){
-      printf("Syntax error (readString): string is not ended with a double quote\n");
-      texit(1);
-    }
-    // read the next character into the string array
-    strArr[index] = next;
-    next = (char)fgetc(stdin);
-    index++;
-  }
-  // store the string terminator
-  strArr[index] = '\0';
-  // store the string array in a value and update the parsed list
-  Value *newVal = talloc(sizeof(Value));
-  newVal->type = STR_TYPE;
-  newVal->s = strArr;
-  return cons(newVal, list);
+  // the string is the text up to the next double quote (without the
+  // quotes); the pool copies it into a buffer of the right length
+  const char *quote = scan(cursor, inputEnd, "\"\xff", 2);
+  // raise error if ending quotes are not detected
+  if (quote == inputEnd || *quote != '"'){
+    reportSyntaxError("Syntax error (readString): string is not ended with a double quote\n");
+  }
+  Value newVal;
+  newVal.type = STR_TYPE;
+  newVal.s = (char *)cursor;
+  newVal.length = quote - cursor;
+  newVal.chars = countChars(cursor, newVal.length);
+  newVal.inBuffer = 0;
+  cursor = quote + 1;
+  return cons(internAtom(&newVal), list);
 }
 
 
 // check if curChar is a digit
 int checkDigit(char curChar){
-  if ((curChar >= 48) && (curChar <= 57)){
-    return 1;
+  return (charClass[(unsigned char)curChar] & CHAR_DIGIT) != 0;
+}
+
+
+// check if curChar ends a symbol or number (including EOF)
+static int checkDelimiter(char curChar){
+  return (charClass[(unsigned char)curChar] & CHAR_DELIMITER) || (curChar == (char)EOF);
+}
+
+
+// the most decimal digits an unsigned 64-bit integer always holds
+#define MAX_MANTISSA_DIGITS 19
+
+
+// reads the digits of a number in base 10 or 16 from p, adding them to
+// *value (which stays at LONG_MAX if it would be larger, like strtol()),
+// and returns the end of the digits
+static const char *readDigits(const char *p, int base, unsigned long *value){
+  unsigned long n = *value;
+  for (; p < inputEnd; p++){
+    int digit;
+    if (checkDigit(*p)){
+      digit = *p - '0';
+    }
+    else if (base == 16 && (*p | 0x20) >= 'a' && (*p | 0x20) <= 'f'){
+      digit = (*p | 0x20) - 'a' + 10;
+    }
+    else{
+      break;
+    }
+    n = (n > (unsigned long)(LONG_MAX - digit) / base) ? LONG_MAX : n * base + digit;
   }
-  else{
+  *value = n;
+  return p;
+}
+
+
+// sets *number to the integer with the sign prefix and the magnitude, and
+// returns 1, or returns 0 if that is out of the range of Value.i (an int)
+static int setInt(Value *number, char prefix, unsigned long magnitude){
+  unsigned long limit = (prefix == '-') ? (unsigned long)INT_MAX + 1 : INT_MAX;
+  if (magnitude > limit){
     return 0;
   }
+  number->type = INT_TYPE;
+  // (negated as a long, where INT_MAX + 1 fits)
+  number->i = (int)((prefix == '-') ? -(long)magnitude : (long)magnitude);
+  return 1;
 }
 
 
+// reads the number starting with curChar (the character before the
+// cursor): digits with at most one '.', then an exponent (e or E, an
+// optional sign and digits) or, after digits only, a '/' and the digits of
+// a denominator. Integers are INT_TYPE, and the others DOUBLE_TYPE, except
+// that a ratio of integers is an integer when it has no remainder (there is
+// no rational type). Integers out of the range of int, and a '/' that does
+// not make a ratio like that, are syntax errors. prefix is its sign.
 Value *readNumber(Value *list, char curChar, char prefix, char *nextToProcessInTokenize){
-  // initialize the value to be INT_TYPE
-  Value *newVal = talloc(sizeof(Value));
-  newVal->type = INT_TYPE;
-  // this is an array to store the current number
-  char *tokenArr = talloc(301*sizeof(char));
-  int index = 0;
-  int countDot = 0; 
-
-  // read the number's characters into tokenArr
+  // (it is read again from the input)
+  (void)curChar;
+  const char *start = cursor - 1;
+  const char *p = start;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int truncated = 0;
+  long exponent = 0;
+  int countDot = 0;
   // note: I did not handle cases like 0.3a, which is
-  // not a number or a symbol. In this tokenizer, 
+  // not a number or a symbol. In this tokenizer,
   // it will read 0.3 as a number and a as a symbol
-  while (checkDigit(curChar) || (curChar == '.')){
-    // if '.' appears, set the value type to double
-    if (curChar == '.'){
+  for (; p < inputEnd && (checkDigit(*p) || *p == '.'); p++){
+    if (*p == '.'){
       // numbers only allow one dot
       if (countDot > 0){
-        printf("Syntax error (readNumber): numbers with >1 decimal dots are not allowed\n");
-        texit(1);
+        reportSyntaxError("Syntax error (readNumber): numbers with >1 decimal dots are not allowed\n");
       }
-      newVal->type = DOUBLE_TYPE;
       countDot++;
     }
-    // read the char into the tokenArr
-    tokenArr[index] = curChar;
-    curChar = (char)fgetc(stdin);
-    index++;
+    else if (digits < MAX_MANTISSA_DIGITS){
+      // (leading zeros don't count)
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += (mantissa != 0);
+      exponent -= countDot;
+    }
+    else{
+      truncated = truncated || (*p != '0');
+      exponent += !countDot;
+    }
+  }
+
+  // an exponent
+  const char *e = p;
+  if (e < inputEnd && (*e == 'e' || *e == 'E')){
+    e++;
+    int negative = (e < inputEnd && *e == '-');
+    if (e < inputEnd && (*e == '+' || *e == '-')){
+      e++;
+    }
+    if (e < inputEnd && checkDigit(*e)){
+      unsigned long power = 0;
+      p = readDigits(e, 10, &power);
+      // (any larger one gives 0 or infinity alike)
+      if (power > 100000){
+        power = 100000;
+      }
+      exponent += negative ? -(long)power : (long)power;
+      countDot++;
+    }
   }
-  tokenArr[index] = '\0';
 
-  // convert from string to number and store it
-  char *ptr; // for using strtol and strtod
-  if (newVal->type == INT_TYPE){
-    long num = strtol(tokenArr, &ptr, 10);//base 10
+  Value newVal;
+  if (countDot > 0){
+    newVal.type = DOUBLE_TYPE;
+    newVal.d = decimalToDouble(mantissa, exponent, truncated, start, p - start);
     if (prefix == '-'){
-      num = num * (-1);
+      newVal.d = -newVal.d;
     }
-    newVal->i = num;
   }
   else{
-    double num = strtod(tokenArr, &ptr);
-    if (prefix == '-'){
-      num = num * (-1);
+    unsigned long numerator = 0;
+    readDigits(start, 10, &numerator);
+    newVal.type = INT_TYPE;
+    unsigned long magnitude = numerator;
+    // a ratio
+    if (p < inputEnd && *p == '/'){
+      if (p + 1 == inputEnd || !checkDigit(p[1])){
+        reportSyntaxError("Syntax error (readNumber): ratio without a denominator\n");
+      }
+      unsigned long denominator = 0;
+      p = readDigits(p + 1, 10, &denominator);
+      if (denominator == 0){
+        reportSyntaxError("Syntax error (readNumber): ratio with a zero denominator\n");
+      }
+      // (it ends at a delimiter, unlike 1/2/3 or 1/2.5)
+      if (p < inputEnd && !checkDelimiter(*p)){
+        reportSyntaxError("Syntax error (readNumber): malformed ratio\n");
+      }
+      // (readDigits stops at LONG_MAX, so the quotient would be wrong)
+      if (numerator == LONG_MAX || denominator == LONG_MAX){
+        reportSyntaxError("Syntax error (readNumber): integer literal out of range\n");
+      }
+      if (numerator % denominator == 0){
+        magnitude = numerator / denominator;
+      }
+      else{
+        newVal.type = DOUBLE_TYPE;
+        newVal.d = (double)numerator / (double)denominator;
+      }
+    }
+    if (newVal.type == INT_TYPE && !setInt(&newVal, prefix, magnitude)){
+      reportSyntaxError("Syntax error (readNumber): integer literal out of range\n");
+    }
+    if (newVal.type == DOUBLE_TYPE && prefix == '-'){
+      newVal.d = -newVal.d;
     }
-    newVal->d = num;
+  }
+  if (countDot > 0 && p < inputEnd && *p == '/'){
+    reportSyntaxError("Syntax error (readNumber): malformed ratio\n");
   }
   // modify the next character to process in tokenize()
-  *nextToProcessInTokenize = curChar;
-  return cons(newVal, list);
+  cursor = p;
+  *nextToProcessInTokenize = nextChar();
+  return cons(internAtom(&newVal), list);
 }
 
 
-int checkSymbolInitial(char curChar){
-  // check if the char is a letter
-  if (((curChar >= 97) && (curChar <= 122)) || ((curChar >= 65) && (curChar <= 90))){
-    return 1;
+// reads a hexadecimal integer, after its #x (with the cursor at the x)
+Value *readHexNumber(Value *list){
+  const char *start = cursor + 1;
+  char prefix = '+';
+  if (start < inputEnd && (*start == '+' || *start == '-')){
+    prefix = *start;
+    start++;
   }
-  // check if the char is an allowed punctuation
-  char puncList[15] = "!$%&*/:<=>?~_^";
-  for (int i = 0; i < 14; i++){
-    if (curChar == puncList[i]){
-      return 1;
-    }
+  unsigned long value = 0;
+  const char *end = readDigits(start, 16, &value);
+  if (end == start){
+    reportSyntaxError("Syntax error (readHexNumber): #x is not followed by hexadecimal digits\n");
   }
-  return 0;
+  Value newVal;
+  if (!setInt(&newVal, prefix, value)){
+    reportSyntaxError("Syntax error (readHexNumber): integer literal out of range\n");
+  }
+  cursor = end;
+  return cons(internAtom(&newVal), list);
+}
+
+
+int checkSymbolInitial(char curChar){
+  // a letter or an allowed punctuation
+  return (charClass[(unsigned char)curChar] & CHAR_INITIAL) != 0;
 }
 
 
 // check if curChar is a valid subsequent in a symbol
 int checkSymbolSubsequent(char curChar){
   // <subsequent> ->  <initial> | <digit> | . | + | -
-  if (checkDigit(curChar) || checkSymbolInitial(curChar) || (curChar == '.') || (curChar == '+') || (curChar == '-')){
-    return 1;
-  }
-  else{
-    return 0;
-  }
+  return (charClass[(unsigned char)curChar] & CHAR_SUBSEQUENT) != 0;
 }
 
 
@@ -173,13 +455,10 @@ int checkSymbolSubsequent(char curChar){
 // while loop in tokenize()
 int checkSymbolEnd(char curChar, char *nextToProcessInTokenize){
   // Identifiers are delimited by whitespace, comments, parentheses, brackets - did not deal with this, string (double) quotes ( " ), and hash marks( # )
-  char endList[7] = "\n\"();#";
-  for (int i = 0; i < 6; i++){
-    if ((curChar == endList[i]) || (curChar == EOF) || (curChar == ' ')){
-      // modify the next character to proceess in the tokenize() function
-      *nextToProcessInTokenize = curChar;
-      return 1;
-    }
+  if (checkDelimiter(curChar)){
+    // modify the next character to proceess in the tokenize() function
+    *nextToProcessInTokenize = curChar;
+    return 1;
   }
   return 0;
 }
@@ -187,67 +466,127 @@ int checkSymbolEnd(char curChar, char *nextToProcessInTokenize){
 
 // reads the symbols + and -
 Value *readPlusMinus(Value *list, char curChar){
-  char *tokenArr = talloc(2*sizeof(char));
+  char tokenArr[2];
   tokenArr[0] = curChar;
   tokenArr[1] = '\0';
   // store the symbol in the s field of the value
-  Value *newVal = talloc(sizeof(Value));
-  newVal->type = SYMBOL_TYPE;
-  newVal->s = tokenArr;
-  return cons(newVal, list);
+  Value newVal;
+  newVal.type = SYMBOL_TYPE;
+  newVal.s = tokenArr;
+  return cons(internAtom(&newVal), list);
 }
 
 
+// reads the symbol starting with curChar (the character before
+// the cursor), up to the next delimiter
 Value *readSymbol(Value *list, char curChar, char *nextToProcessInTokenize){
-  // this is an array to store the current symbol
-  char *tokenArr = talloc(301*sizeof(char));
-  int index = 0; 
-
-  while (checkSymbolEnd(curChar, nextToProcessInTokenize) != 1){
-    if (checkSymbolSubsequent(curChar) != 1){
-      printf("Syntax error (readSymbol): symbol with %c is not allowed", curChar);
-      texit(1);
+  // (it is read again from the input)
+  (void)curChar;
+  const char *start = cursor - 1;
+  const char *end = scan(cursor, inputEnd, delimiters, NUM_DELIMITERS);
+  for (const char *p = start; p < end; p++){
+    if (!checkSymbolSubsequent(*p)){
+      reportSyntaxError("Syntax error (readSymbol): symbol with %c is not allowed", *p);
     }
-    tokenArr[index] = curChar;
-    curChar = (char)fgetc(stdin);
-    index++;
   }
-  tokenArr[index] = '\0';
-
+  cursor = end;
+  *nextToProcessInTokenize = nextChar();
+
+  // the pool copies the symbol from this NUL-terminated copy
+  char tokenArrOnStack[301];
+  size_t length = end - start;
+  char *tokenArr = (length < sizeof(tokenArrOnStack)) ? tokenArrOnStack : malloc(length + 1);
+  assert(tokenArr != NULL && "Error (readSymbol): out of memory");
+  memcpy(tokenArr, start, length);
+  tokenArr[length] = '\0';
   // store the symbol in the s field of the value
-  Value *newVal = talloc(sizeof(Value));
-  newVal->type = SYMBOL_TYPE;
-  newVal->s = tokenArr;
-  return cons(newVal, list);
+  Value newVal;
+  newVal.type = SYMBOL_TYPE;
+  newVal.s = tokenArr;
+  Value *symbol = internAtom(&newVal);
+  if (tokenArr != tokenArrOnStack){
+    free(tokenArr);
+  }
+  return cons(symbol, list);
 }
 
 
 void skipComments(){
-  char next = (char)fgetc(stdin);
-  // ignore everything after ; in a line
-  while ((next != '\n') && (next!= EOF)){
-    next = (char)fgetc(stdin);
-  }
+  // ignore everything after ; in a line (and the newline)
+  const char *newline = scan(cursor, inputEnd, "\n\xff", 2);
+  cursor = (newline == inputEnd) ? inputEnd : newline + 1;
   return;
 }
 
 
 // Read all of the input from stdin, and return a linked list consisting of the tokens.
 Value *tokenize() {
+  return tokenizeFile(stdin);
+}
+
+
+// Read all of the input from stream, and return a linked list consisting of
+// the tokens.
+Value *tokenizeFile(FILE *stream) {
+  // the whole input is read first, into a buffer the size of the file
+  // (one byte more, to see the end) or else one that doubles in size
+  size_t capacity = 64 * 1024;
+  struct stat status;
+  int fd = fileno(stream);
+  if (fd >= 0 && fstat(fd, &status) == 0 && S_ISREG(status.st_mode) &&
+      (size_t)status.st_size >= capacity){
+    capacity = (size_t)status.st_size + 1;
+  }
+  size_t length = 0;
+  char *text = talloc(capacity);
+  size_t read;
+  while ((read = fread(text + length, 1, capacity - length, stream)) > 0){
+    length += read;
+    if (length == capacity){
+      char *bigger = talloc(2 * capacity);
+      memcpy(bigger, text, length);
+      trelease(text, capacity);
+      text = bigger;
+      capacity *= 2;
+    }
+  }
+  Value *tokens = tokenizeBuffer(text, length);
+  trelease(text, capacity);
+  return tokens;
+}
+
+
+// Returns the tokens of the length bytes of program text at text.
+Value *tokenizeBuffer(const char *text, size_t length) {
+  pthread_once(&scanOnce, chooseScan);
+  cursor = text;
+  inputEnd = text + length;
   // use a memory on heap to track the character read
   char *charRead = talloc(2*sizeof(char));
   Value *list = makeNull();
-  *charRead = (char)fgetc(stdin);
+  *charRead = nextChar();
 
-  while (*charRead != EOF) {
-    // read in parentheses
-    if ((*charRead == '(' )|| (*charRead == ')')){
+  while (*charRead != (char)EOF) {
+    // read in parentheses and brackets
+    if ((*charRead == '(' )|| (*charRead == ')') || (*charRead == '[') || (*charRead == ']')){
       list = readPar(list, *charRead);
     }
 
-    // read in booleans
+    // read in quote marks, and dots on their own
+    // (i.e. followed by a delimiter, unlike those of numbers)
+    else if ((*charRead == '\'') ||
+             ((*charRead == '.') && (cursor == inputEnd || checkDelimiter(*cursor)))){
+      list = readMark(list, *charRead);
+    }
+
+    // read in booleans and hexadecimal numbers
     else if (*charRead == '#'){
-      list = readBoolean(list);
+      if (cursor != inputEnd && (*cursor == 'x' || *cursor == 'X')){
+        list = readHexNumber(list);
+      }
+      else{
+        list = readBoolean(list);
+      }
     } 
 
     // read in string
@@ -269,7 +608,7 @@ Value *tokenize() {
 
     // read in symbols/numbers starting with '+', '-', '.'
     else if ((*charRead == '+') || (*charRead == '-')){
-      char next = (char)fgetc(stdin);
+      char next = nextChar();
       // expect a number if the next char is a digit
       if (checkDigit(next)){
         list = readNumber(list, next, *charRead, charRead);
@@ -303,14 +642,16 @@ Value *tokenize() {
     // if char is not of any of the types above
     // report a syntax error       
     else {
-      printf("Syntax error (tokenize): character %c is not allowed in this tokenizer", *charRead);
-      texit(1);      
+      reportSyntaxError("Syntax error (tokenize): character %c is not allowed in this tokenizer", *charRead);
     }
     // note: once EOF is reached, all future reads are EOF
-    *charRead = (char)fgetc(stdin);
+    *charRead = nextChar();
   }
 
   Value *revList = reverse(list);
+  // the tokens were collected in reverse order; the
+  // cells of that list can be reused by the parser
+  releaseCells(list);
   return revList;
 }
 
@@ -326,6 +667,18 @@ void displayTokens(Value *list){
       case CLOSE_TYPE:
         printf("%s:close\n", (car(curVal))->s);
         break;
+      case OPENBRACKET_TYPE:
+        printf("%s:openbracket\n", (car(curVal))->s);
+        break;
+      case CLOSEBRACKET_TYPE:
+        printf("%s:closebracket\n", (car(curVal))->s);
+        break;
+      case DOT_TYPE:
+        printf("%s:dot\n", (car(curVal))->s);
+        break;
+      case SINGLEQUOTE_TYPE:
+        printf("%s:quote\n", (car(curVal))->s);
+        break;
       case BOOL_TYPE:
         if ((car(curVal))->i){
           printf("#t:boolean\n");
@@ -349,13 +702,10 @@ void displayTokens(Value *list){
       case CONS_TYPE:
       case NULL_TYPE:
       case PTR_TYPE:
-      case OPENBRACKET_TYPE:
-      case CLOSEBRACKET_TYPE:
-      case DOT_TYPE:
-      case SINGLEQUOTE_TYPE:
       case VOID_TYPE:
       case CLOSURE_TYPE:
       case PRIMITIVE_TYPE:
+      case FUTURE_TYPE:
         break;    
     }
     curVal = cdr(curVal);
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "value.h"
 
 #ifndef _TOKENIZER
@@ -7,6 +8,17 @@
 // tokens.
 Value *tokenize();
 
+// Same as tokenize(), reading from stream instead of stdin.
+Value *tokenizeFile(FILE *stream);
+
+// Same as tokenize(), for the length bytes of program text at text.
+Value *tokenizeBuffer(const char *text, size_t length);
+
+// Returns the first byte in [start, end) that is one of the count (at most
+// 10) bytes at needles, or end, searching many bytes at a time where the
+// processor can.
+const char *scanFor(const char *start, const char *end, const char *needles, int count);
+
 // Displays the contents of the linked list as tokens, with type information
 void displayTokens(Value *list);
 
@@ -14,33 +14,63 @@ typedef enum {
     // Type below is new for primitive portion
     PRIMITIVE_TYPE,
 
+    // Type below is for (future expr)
+    FUTURE_TYPE,
+
 } valueType;
 
+// For purposes of this project a closure is just another type of value,
+// containing everything needed to execute a user-defined function: (1) a list
+// of formal parameter names; (2) a pointer to the function body; (3) a pointer
+// to the environment frame in which the function was created.
+// It is kept outside of the Value union: it is the only member larger than a
+// cons cell, and storing it inline would make every Value (most of which are
+// cons cells) a full word bigger.
+struct Closure {
+    struct Value *paramNames;
+    struct Value *fnBody;
+    struct Frame *frame;
+    // the values of purityEpoch (in interpreter.c) for which the
+    // closure is known to be pure or impure, for the parallel mode
+    int pureEpoch;
+    int impureEpoch;
+    // for a memoized closure (see memo.h), the number of results it keeps
+    // and the cache holding them; 0 and NULL for other closures
+    int memoCapacity;
+    struct Memo *memo;
+};
+
+typedef struct Closure Closure;
+
 struct Value {
     valueType type;
     union {
         int i;
         double d;
-        char *s;
+        // the text of a string or symbol; a string also holds its length
+        // in bytes and in characters, and its text need not end in a NUL
+        // byte (see text.h)
+        struct {
+            char *s;
+            int length;
+            unsigned int chars : 31;
+            unsigned int inBuffer : 1;
+        };
         void *p;
         struct ConsCell {
             struct Value *car;
             struct Value *cdr;
         } c;
-        // For purposes of this project a closure is just another type of value,
-        // containing everything needed to execute a user-defined function: (1)
-        // a list of formal parameter names; (2) a pointer to the function body;
-        // (3) a pointer to the environment frame in which the function was
-        // created.
-        struct Closure {
-            struct Value *paramNames;
-            struct Value *fnBody;
-            struct Frame *frame;
-        } closure;
+        // A closure value only holds a pointer to its Closure
+        struct Closure *closure;
         
         // A primitive style function; just a pointer to it, with the right
         // signature (primFn = primitive function)
         struct Value *(*primFn)(struct Value *);
+
+        // A future only holds a pointer to the task computing its value
+        // (see EvalTask in interpreter.c)
+        struct EvalTask *future;
     };
 };
 